@@ -1,238 +1,473 @@
-#include "include/CylinderContainer.hpp"
-
-double CylinderContainer::get_mass_kg() const {
-    double COPPER_DENSITY_KGPM3 = 8940;
-    
-    return get_volume_m3() * COPPER_DENSITY_KGPM3;
-}
-
-double CylinderContainer::get_volume_m3() const {
-    double pipe_exterior_diameter_m = pipe_interior_diameter_m_ + (2 * thickness_m_);
-    double pipe_inner_radius_squared_m2 = std::pow(pipe_interior_diameter_m_ / 2, 2);
-    double pipe_outer_radius_squared_m2 = std::pow(pipe_exterior_diameter_m / 2, 2);
-    
-    return M_PI * 
-           pipe_length_m_ * 
-           (pipe_outer_radius_squared_m2 - pipe_inner_radius_squared_m2);
-}
-
-double CylinderContainer::get_water_mass_kg() {
-    double pipe_interior_volume_m3 = M_PI * 
-                                     std::pow(pipe_interior_diameter_m_ / 2, 2) * 
-                                     pipe_length_m_;
-    return pipe_interior_volume_m3 * get_water_density_kgpm3(water_temperature_C_);
-}
-
-double CylinderContainer::get_pipe_cross_sectional_area_m2(bool is_inner_diameter = true){
-    double pipe_diameter = is_inner_diameter 
-                                ? pipe_interior_diameter_m_ 
-                                : pipe_interior_diameter_m_ + (2 * thickness_m_);
-    return M_PI * (std::pow(pipe_diameter, 2) / 4);
-}
-
-double CylinderContainer::get_flow_velocity(double water_temperature_C){
-    return water_mass_flow_rate_kgps_ / 
-           (get_water_density_kgpm3(water_temperature_C) * get_pipe_cross_sectional_area_m2());
-}
-
-double CylinderContainer::get_air_mass_flow_rate_kgps(double tempurature_C, 
-                                                      Environment environment, 
-                                                      double current_time){
-    return environment.get_air_density_kgpm3(tempurature_C) * 
-           get_pipe_cross_sectional_area_m2(/*is_inner*/ false) * 
-           environment.get_wind_speed(current_time);
-}
-
-double CylinderContainer::get_pipe_surface_area_m2(bool is_inner_diameter = true){
-    double pipe_diameter = is_inner_diameter 
-                                ? pipe_interior_diameter_m_ 
-                                : pipe_interior_diameter_m_ + (2 * thickness_m_);
-    return M_PI * pipe_diameter * pipe_length_m_;
-}
-
-double CylinderContainer::get_fully_developed_velocity_in_pipe_m(double reynolds_number){
-    return reynolds_number < LAMINAR_FLOW_UPPER_BOUND 
-                                ? 0.05 * reynolds_number * pipe_interior_diameter_m_
-                                : TURBULENT_FLOW_FULLY_DEVELOPED_DISTANCE_M * pipe_interior_diameter_m_;
-}
-
-double CylinderContainer::get_fully_developed_temperature_in_pipe_m(double reynolds_number, 
-                                                                    double prandtl_number = 0.0){
-    return reynolds_number < LAMINAR_FLOW_UPPER_BOUND 
-                                ? 0.05 * reynolds_number * prandtl_number * pipe_interior_diameter_m_
-                                : TURBULENT_FLOW_FULLY_DEVELOPED_DISTANCE_M * pipe_interior_diameter_m_;
-}
-
-double CylinderContainer::get_cylinder_convective_coefficient_Wpm2K(double water_temperature_C, 
-                                                                    Environment environment = {}, 
-                                                                    double current_time_s=-1.0){
-    // Fluid properties and pipe diameter (the characteristic length) determined based on fluid
-    double density_kgpm3, dynamic_viscosity_kgpms, flow_velocity_mps;
-    double specific_heat_capacity_JpkgC, thermal_conductivity_WpmK, characteristic_length_m;
-    if(current_time_s < 0){
-        characteristic_length_m = pipe_interior_diameter_m_;
-        dynamic_viscosity_kgpms = get_water_dynamic_viscosity_kgpms(water_temperature_C); // μ
-        thermal_conductivity_WpmK = get_water_thermal_conductivity_WpmK(water_temperature_C); // k
-        density_kgpm3 = get_water_density_kgpm3(water_temperature_C); // ρ
-        flow_velocity_mps = get_flow_velocity(water_temperature_C);
-        specific_heat_capacity_JpkgC = get_water_specific_heat_capacity_JpkgC(water_temperature_C); // C_p
-    }
-    else {
-        double air_temperature_C = environment.get_ambient_temperature(current_time_s);
-        characteristic_length_m = pipe_interior_diameter_m_ + (2 * thickness_m_); // Exterior Diameter
-        dynamic_viscosity_kgpms = environment.get_air_dynamic_viscosity_kgpms(air_temperature_C); // μ
-        thermal_conductivity_WpmK = environment.get_air_thermal_conductivity_WpmK(air_temperature_C); // k
-        density_kgpm3 = environment.get_air_density_kgpm3(air_temperature_C); // ρ
-        flow_velocity_mps = environment.get_wind_speed(current_time_s);
-        specific_heat_capacity_JpkgC = environment.get_air_specific_heat_capacity_JpkgC(air_temperature_C); // C_p
-    }
-    
-    double reynolds_number = (density_kgpm3 * flow_velocity_mps * characteristic_length_m) / 
-                                dynamic_viscosity_kgpms;
-    // Alternative method for calculating reynolds number
-    // double mass_flow_rate_kgps = (current_time_s < 0)
-    //                                     ? water_mass_flow_rate_kgps_ 
-    //                                     : get_air_mass_flow_rate_kgps(air_temperature_C, environment, current_time_s);
-    // [[maybe_unused]] double reynolds_number_2 = 4 * mass_flow_rate_kgps / 
-    //                             (M_PI * dynamic_viscosity_kgpms * characteristic_length_m);
-
-    double prandtl_number = specific_heat_capacity_JpkgC * dynamic_viscosity_kgpms / thermal_conductivity_WpmK;
-    
-    double nusselt_number;
-    if(current_time_s < 0 && reynolds_number < LAMINAR_FLOW_UPPER_BOUND){ // Laminar flow
-        bool is_fully_developed_temperature = 
-                        pipe_length_m_ >= get_fully_developed_temperature_in_pipe_m(reynolds_number, prandtl_number);
-        bool is_fully_developed_velocity = pipe_length_m_ >= get_fully_developed_velocity_in_pipe_m(reynolds_number);
-        
-        double graete_number = (pipe_interior_diameter_m_ / pipe_length_m_) * reynolds_number * prandtl_number;
-
-        // Assumes constant surface tempurature across surface
-        if(is_fully_developed_velocity && is_fully_developed_temperature){
-            nusselt_number = 3.66;
-        }
-        else if(is_fully_developed_velocity && !is_fully_developed_temperature){
-            nusselt_number = 3.66 + (0.0668 * graete_number) / (1 + 0.04 * std::pow(graete_number, 0.666));
-        }
-        else if(!is_fully_developed_velocity && !is_fully_developed_temperature){
-            nusselt_number = (3.66 / 
-                                tanh(std::pow(2.264 * graete_number, -0.333) + std::pow(1.7 * graete_number, -0.666)) +
-                                (0.0499 * graete_number * tanh(std::pow(graete_number, -1)))) /
-                                tanh(2.432 * std::pow(prandtl_number, 0.166) * std::pow(graete_number, -0.166));
-        }
-        else{
-            throw std::runtime_error("Error: NOT fully developed velocity WITH fully developed temperature\n");
-        }
-    } 
-    else if (current_time_s < 0) { // Turbulent flow
-        double prandtl_power = (water_temperature_C < temperature_C_) ? 0.3 : 0.4; // water is heating vs cooling
-        nusselt_number = 0.023 * std::pow(reynolds_number, 0.8) * std::pow(prandtl_number, prandtl_power);
-    } 
-    else { // Air
-        // Churchill-Bernstein equation - used for flow over a cylinder
-        nusselt_number = 0.3 + (0.62 * std::pow(reynolds_number, 0.5) * std::pow(prandtl_number, 0.333)) / 
-                                std::pow(1 + std::pow(0.4 / prandtl_number, 0.666), 0.25) * 
-                                std::pow(1 + std::pow(reynolds_number / 282000, 0.625), 0.8);
-    }
-
-    // Calculate convection coefficient (h)
-    return (nusselt_number * thermal_conductivity_WpmK) / characteristic_length_m;
-}
-
-void CylinderContainer::one_second_update_temperature(double intake_water_temperature_C, 
-                                           Environment environment, 
-                                           double current_time){
-    
-    if(get_mass_kg() <= 0.0 || specific_heat_capacity_JpkgC_ <= 0.0){
-        throw std::invalid_argument( "Error: Pipe mass or specific heat <= 0" );
-    }
-
-    static const int MAX_ITERATIONS = 25;
-    static const double TEMPURATURE_THRESHOLD_C = 0.001;
-
-    intake_water_temperature_C = std::clamp(intake_water_temperature_C, 
-                                            min_temperature_C_, 
-                                            max_temperature_C_);
-                                            
-    /// (1) Update water tempurature
-    if(is_tank_){
-        double heat_added_W = (intake_water_temperature_C - water_temperature_C_) * 
-                              water_mass_flow_rate_kgps_ * 
-                              get_water_specific_heat_capacity_JpkgC(intake_water_temperature_C);
-        add_heat_to_water(heat_added_W); // evaluating over a single second -> Joules
-    }
-    else{
-        set_water_temperature(intake_water_temperature_C);
-    }
-
-    /// (2) Calculate heat gained for pipe
-    if(is_exposed_)
-    {
-        /// (2a) Heat trasnfer from SUN --> Copper Pipe
-        double solar_absorbtion_W = environment.get_solar_irradiance_Wpm2(current_time) * 
-                                        get_pipe_surface_area_m2(/*is_inner*/ false) * emissivity_;
-
-        /// (2b) Convective Heat Transfer between Copper Pipe and Air
-        double air_heat_transfer_coefficient = get_cylinder_convective_coefficient_Wpm2K(0, 
-                                                                                         environment, 
-                                                                                         current_time);
-        double heat_transfered_to_air_W = air_heat_transfer_coefficient * 
-                                            get_pipe_surface_area_m2(/*is_inner*/ false) * 
-                                            (temperature_C_ - 
-                                             environment.get_ambient_temperature(current_time));
-
-        double heat_added_by_environment_W = solar_absorbtion_W - heat_transfered_to_air_W;
-
-        add_tempurature(heat_added_by_environment_W); // evaluating over a single second -> Joules
-    }
-
-    /// (3) Heat Transfer between Pipe and Water
-    double starting_water_temperature_C = water_temperature_C_;
-    double previous_water_out_tempurature_C = starting_water_temperature_C;
-
-    // Mean water tempurature is unknown since the tempurature out of the pipe is being calculated
-    // (3a) Initially assume the final tempurature is equal to the pipe tempurature
-    double mean_water_temperature_C = (starting_water_temperature_C + temperature_C_) / 2;
-    double water_heat_transfer_coefficient, updated_water_out_temperature_C;
-
-    // (3b) Repeating the calculation, updating the output (and mean) tempurature each step
-    // (3c) Exit when completing MAX_ITERATIONS or when the delta between of the last calculation is 
-    //      less then TEMPURATURE_THRESHOLD_C
-    for(int iterations = 0; iterations < MAX_ITERATIONS; iterations++){
-        water_heat_transfer_coefficient = get_cylinder_convective_coefficient_Wpm2K(mean_water_temperature_C);
-        updated_water_out_temperature_C = 
-                temperature_C_ - (temperature_C_ - starting_water_temperature_C) * 
-                                    exp(((-get_pipe_surface_area_m2() * 
-                                            water_heat_transfer_coefficient) / 
-                                          (water_mass_flow_rate_kgps_ * 
-                                            get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C))
-                                        ));
-        
-        updated_water_out_temperature_C = std::clamp(updated_water_out_temperature_C, 
-                                                     min_temperature_C_, 
-                                                     max_temperature_C_);
-        mean_water_temperature_C = (starting_water_temperature_C + updated_water_out_temperature_C) / 2;
-
-        if(std::abs(previous_water_out_tempurature_C - updated_water_out_temperature_C) < TEMPURATURE_THRESHOLD_C ||
-           iterations == (MAX_ITERATIONS - 1)){
-            break;
-        }
-
-        previous_water_out_tempurature_C = updated_water_out_temperature_C;
-    }
-
-    /// (4) Update Cylinder temps
-    double heat_transfered_to_water_W = water_mass_flow_rate_kgps_ * 
-                                        get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C) * 
-                                        (updated_water_out_temperature_C - starting_water_temperature_C);
-
-    add_tempurature(-heat_transfered_to_water_W); // evaluating over a single second -> Joules
-
-    water_out_temperature_C_ = updated_water_out_temperature_C;
-}
-
-void CylinderContainer::add_heat_to_water(double total_energy_added_J) { 
-    double water_tempurature_delta_K = total_energy_added_J / 
-                                        (get_water_specific_heat_capacity_JpkgC(water_temperature_C_) * 
-                                         get_water_mass_kg());
-    water_temperature_C_ += water_tempurature_delta_K; 
-}
+#include <numeric>
+
+#include "include/CylinderContainer.hpp"
+
+Real CylinderContainer::get_mass_kg() const {
+    double COPPER_DENSITY_KGPM3 = 8940;
+    
+    return get_volume_m3() * COPPER_DENSITY_KGPM3;
+}
+
+Real CylinderContainer::get_volume_m3() const {
+    Real pipe_exterior_diameter_m = pipe_interior_diameter_m_ + (2 * thickness_m_);
+    Real pipe_inner_radius_squared_m2 = pow(pipe_interior_diameter_m_ / 2, 2);
+    Real pipe_outer_radius_squared_m2 = pow(pipe_exterior_diameter_m / 2, 2);
+    
+    return M_PI * 
+           pipe_length_m_ * 
+           (pipe_outer_radius_squared_m2 - pipe_inner_radius_squared_m2);
+}
+
+void CylinderContainer::print_cache_key(std::ostream &key) const {
+    ThermodynamicObject::print_cache_key(key);
+    key << " " << is_tank_ << " " << is_exposed_ << " " << value_of(pipe_length_m_)
+        << " " << value_of(max_temperature_C_) << " " << value_of(min_temperature_C_)
+        << " " << value_of(pipe_interior_diameter_m_) << " " << value_of(water_mass_flow_rate_kgps_)
+        << " " << layer_temperatures_C_.size();
+}
+
+Real CylinderContainer::get_water_mass_kg() {
+    Real pipe_interior_volume_m3 = M_PI * 
+                                     pow(pipe_interior_diameter_m_ / 2, 2) * 
+                                     pipe_length_m_;
+    return pipe_interior_volume_m3 * get_water_density_kgpm3(water_temperature_C_);
+}
+
+Real CylinderContainer::get_pipe_cross_sectional_area_m2(bool is_inner_diameter = true){
+    Real pipe_diameter = is_inner_diameter 
+                                ? pipe_interior_diameter_m_ 
+                                : pipe_interior_diameter_m_ + (2 * thickness_m_);
+    return M_PI * (pow(pipe_diameter, 2) / 4);
+}
+
+Real CylinderContainer::get_flow_velocity(Real water_temperature_C){
+    return water_mass_flow_rate_kgps_ / 
+           (get_water_density_kgpm3(water_temperature_C) * get_pipe_cross_sectional_area_m2());
+}
+
+Real CylinderContainer::get_air_mass_flow_rate_kgps(Real tempurature_C, 
+                                                      const Environment &environment, 
+                                                      double current_time){
+    return environment.get_air_density_kgpm3(tempurature_C) * 
+           get_pipe_cross_sectional_area_m2(/*is_inner*/ false) * 
+           environment.get_wind_speed(current_time);
+}
+
+Real CylinderContainer::get_pipe_surface_area_m2(bool is_inner_diameter = true){
+    Real pipe_diameter = is_inner_diameter 
+                                ? pipe_interior_diameter_m_ 
+                                : pipe_interior_diameter_m_ + (2 * thickness_m_);
+    return M_PI * pipe_diameter * pipe_length_m_;
+}
+
+Real CylinderContainer::get_fully_developed_velocity_in_pipe_m(Real reynolds_number){
+    return reynolds_number < LAMINAR_FLOW_UPPER_BOUND 
+                                ? 0.05 * reynolds_number * pipe_interior_diameter_m_
+                                : TURBULENT_FLOW_FULLY_DEVELOPED_DISTANCE_M * pipe_interior_diameter_m_;
+}
+
+Real CylinderContainer::get_fully_developed_temperature_in_pipe_m(Real reynolds_number, 
+                                                                    Real prandtl_number = 0.0){
+    return reynolds_number < LAMINAR_FLOW_UPPER_BOUND 
+                                ? 0.05 * reynolds_number * prandtl_number * pipe_interior_diameter_m_
+                                : TURBULENT_FLOW_FULLY_DEVELOPED_DISTANCE_M * pipe_interior_diameter_m_;
+}
+
+Real CylinderContainer::get_cylinder_convective_coefficient_Wpm2K(Real water_temperature_C, 
+                                                                    const Environment &environment = {}, 
+                                                                    double current_time_s=-1.0){
+    // Fluid properties and pipe diameter (the characteristic length) determined based on fluid
+    Real density_kgpm3, dynamic_viscosity_kgpms, flow_velocity_mps;
+    Real specific_heat_capacity_JpkgC, thermal_conductivity_WpmK, characteristic_length_m;
+    if(current_time_s < 0){
+        characteristic_length_m = pipe_interior_diameter_m_;
+        dynamic_viscosity_kgpms = get_water_dynamic_viscosity_kgpms(water_temperature_C); // μ
+        thermal_conductivity_WpmK = get_water_thermal_conductivity_WpmK(water_temperature_C); // k
+        density_kgpm3 = get_water_density_kgpm3(water_temperature_C); // ρ
+        flow_velocity_mps = get_flow_velocity(water_temperature_C);
+        specific_heat_capacity_JpkgC = get_water_specific_heat_capacity_JpkgC(water_temperature_C); // C_p
+    }
+    else {
+        Real air_temperature_C = environment.get_ambient_temperature(current_time_s);
+        characteristic_length_m = pipe_interior_diameter_m_ + (2 * thickness_m_); // Exterior Diameter
+        dynamic_viscosity_kgpms = environment.get_air_dynamic_viscosity_kgpms(air_temperature_C); // μ
+        thermal_conductivity_WpmK = environment.get_air_thermal_conductivity_WpmK(air_temperature_C); // k
+        density_kgpm3 = environment.get_air_density_kgpm3(air_temperature_C); // ρ
+        flow_velocity_mps = environment.get_wind_speed(current_time_s);
+        specific_heat_capacity_JpkgC = environment.get_air_specific_heat_capacity_JpkgC(air_temperature_C); // C_p
+    }
+    
+    Real reynolds_number = (density_kgpm3 * flow_velocity_mps * characteristic_length_m) / 
+                                dynamic_viscosity_kgpms;
+    // Alternative method for calculating reynolds number
+    // Real mass_flow_rate_kgps = (current_time_s < 0)
+    //                                     ? water_mass_flow_rate_kgps_ 
+    //                                     : get_air_mass_flow_rate_kgps(air_temperature_C, environment, current_time_s);
+    // [[maybe_unused]] Real reynolds_number_2 = 4 * mass_flow_rate_kgps / 
+    //                             (M_PI * dynamic_viscosity_kgpms * characteristic_length_m);
+
+    Real prandtl_number = specific_heat_capacity_JpkgC * dynamic_viscosity_kgpms / thermal_conductivity_WpmK;
+    
+    Real nusselt_number;
+    if(current_time_s < 0 && reynolds_number < LAMINAR_FLOW_UPPER_BOUND){ // Laminar flow
+        bool is_fully_developed_temperature = 
+                        pipe_length_m_ >= get_fully_developed_temperature_in_pipe_m(reynolds_number, prandtl_number);
+        bool is_fully_developed_velocity = pipe_length_m_ >= get_fully_developed_velocity_in_pipe_m(reynolds_number);
+        
+        Real graete_number = (pipe_interior_diameter_m_ / pipe_length_m_) * reynolds_number * prandtl_number;
+
+        // Assumes constant surface tempurature across surface
+        if(is_fully_developed_velocity && is_fully_developed_temperature){
+            nusselt_number = 3.66;
+        }
+        else if(is_fully_developed_velocity && !is_fully_developed_temperature){
+            nusselt_number = 3.66 + (0.0668 * graete_number) / (1 + 0.04 * pow(graete_number, 0.666));
+        }
+        else if(!is_fully_developed_velocity && !is_fully_developed_temperature){
+            nusselt_number = (3.66 / 
+                                tanh(pow(2.264 * graete_number, -0.333) + pow(1.7 * graete_number, -0.666)) +
+                                (0.0499 * graete_number * tanh(pow(graete_number, -1)))) /
+                                tanh(2.432 * pow(prandtl_number, 0.166) * pow(graete_number, -0.166));
+        }
+        else{
+            throw std::runtime_error("Error: NOT fully developed velocity WITH fully developed temperature\n");
+        }
+    } 
+    else if (current_time_s < 0) { // Turbulent flow
+        double prandtl_power = (water_temperature_C < temperature_C_) ? 0.3 : 0.4; // water is heating vs cooling
+        nusselt_number = 0.023 * pow(reynolds_number, 0.8) * pow(prandtl_number, prandtl_power);
+    } 
+    else { // Air
+        // Churchill-Bernstein equation - used for flow over a cylinder
+        nusselt_number = 0.3 + (0.62 * pow(reynolds_number, 0.5) * pow(prandtl_number, 0.333)) / 
+                                pow(1 + pow(0.4 / prandtl_number, 0.666), 0.25) * 
+                                pow(1 + pow(reynolds_number / 282000, 0.625), 0.8);
+    }
+
+    // Calculate convection coefficient (h)
+    return (nusselt_number * thermal_conductivity_WpmK) / characteristic_length_m;
+}
+
+void CylinderContainer::get_environment_heat_flows_W(const Environment &environment, 
+                                                     double current_time,
+                                                     Real &solar_absorbtion_W, 
+                                                     Real &heat_transfered_to_air_W){
+    /// (2a) Heat trasnfer from SUN --> Copper Pipe
+    solar_absorbtion_W = environment.get_solar_irradiance_Wpm2(current_time) * 
+                         get_pipe_surface_area_m2(/*is_inner*/ false) * emissivity_;
+
+    /// (2b) Convective Heat Transfer between Copper Pipe and Air
+    Real air_heat_transfer_coefficient = get_cylinder_convective_coefficient_Wpm2K(0, 
+                                                                                   environment, 
+                                                                                   current_time);
+    heat_transfered_to_air_W = air_heat_transfer_coefficient * 
+                               get_pipe_surface_area_m2(/*is_inner*/ false) * 
+                               (temperature_C_ - 
+                                environment.get_ambient_temperature(current_time));
+}
+
+// Fraction of the wall to inlet temperature difference the water closes over the pipe length
+Real CylinderContainer::get_water_effectiveness(Real mean_water_temperature_C){
+    Real water_heat_transfer_coefficient = get_cylinder_convective_coefficient_Wpm2K(mean_water_temperature_C);
+    return 1.0 - exp((-get_pipe_surface_area_m2() * water_heat_transfer_coefficient) / 
+                     (water_mass_flow_rate_kgps_ * 
+                      get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C)));
+}
+
+void CylinderContainer::one_second_update_temperature(Real intake_water_temperature_C, 
+                                           const Environment &environment, 
+                                           double current_time){
+    one_second_update_surroundings(environment, current_time);
+    one_second_update_water(intake_water_temperature_C);
+}
+
+// First half of a one second update: everything that does not depend on the water coming in, so
+// it can run before the upstream component has finished the same second (see Simulation::propagate_pipelined)
+void CylinderContainer::one_second_update_surroundings(const Environment &environment, double current_time){
+    
+    if(get_mass_kg() <= 0.0 || specific_heat_capacity_JpkgC_ <= 0.0){
+        throw std::invalid_argument( "Error: Pipe mass or specific heat <= 0" );
+    }
+
+    energy_flows_ = {};
+
+    /// (2) Calculate heat gained for pipe
+    if(is_exposed_)
+    {
+        Real solar_absorbtion_W, heat_transfered_to_air_W;
+        get_environment_heat_flows_W(environment, current_time, solar_absorbtion_W, heat_transfered_to_air_W);
+
+        Real heat_added_by_environment_W = solar_absorbtion_W - heat_transfered_to_air_W;
+
+        add_tempurature(heat_added_by_environment_W); // evaluating over a single second -> Joules
+        energy_flows_.solar_absorbed_J = solar_absorbtion_W;
+        energy_flows_.convective_loss_J = heat_transfered_to_air_W;
+    }
+}
+
+// Second half of a one second update: water comes in at intake_water_temperature_C and exchanges
+// heat with the wall. Step (1) only touches the water and step (2) only the wall, so running (2)
+// first gives the same result
+void CylinderContainer::one_second_update_water(Real intake_water_temperature_C){
+
+    intake_water_temperature_C = std::clamp<Real>(intake_water_temperature_C, 
+                                            min_temperature_C_, 
+                                            max_temperature_C_);
+                                            
+    /// (1) Update water tempurature
+    if(is_tank_ && is_stratified()){
+        energy_flows_.water_heat_input_J = update_stratified_water(intake_water_temperature_C, 
+                                                                   /*time_step_s*/ 1.0);
+        water_temperature_C_ = layer_temperatures_C_.back(); // Supply is drawn from the bottom layer
+    }
+    else if(is_tank_){
+        Real heat_added_W = (intake_water_temperature_C - water_temperature_C_) * 
+                              water_mass_flow_rate_kgps_ * 
+                              get_water_specific_heat_capacity_JpkgC(intake_water_temperature_C);
+        add_heat_to_water(heat_added_W); // evaluating over a single second -> Joules
+        energy_flows_.water_heat_input_J = heat_added_W;
+    }
+    else{
+        set_water_temperature(intake_water_temperature_C);
+    }
+
+    /// (3) Heat Transfer between Pipe and Water
+    Real updated_water_out_temperature_C, heat_transfered_to_water_W;
+    if(!outlet_surrogate_.lookup(water_temperature_C_, temperature_C_, 
+                                 updated_water_out_temperature_C, heat_transfered_to_water_W)){
+        solve_water_outlet(water_temperature_C_, updated_water_out_temperature_C, heat_transfered_to_water_W);
+    }
+
+    /// (4) Update Cylinder temps
+    add_tempurature(-heat_transfered_to_water_W); // evaluating over a single second -> Joules
+    energy_flows_.transferred_to_water_J = heat_transfered_to_water_W;
+
+    water_out_temperature_C_ = updated_water_out_temperature_C;
+}
+
+// Advances step_s seconds with the pump off. The water stands still and only exchanges heat with
+// the wall by conduction (Nusselt number of fully developed laminar flow). The wall follows the
+// exact solution of its heat balance linearized at the start of the step, with the sun, the air,
+// the water and an optional conductance to a source (the panel, for the pipe on it) held fixed;
+// the water then relaxes toward the new wall temperature. Both are exponential, so steps of any
+// length stay stable. Energy flows hold the step's totals.
+void CylinderContainer::idle_update_temperature(const Environment &environment, 
+                                                double current_time_s, 
+                                                double step_s, 
+                                                Real source_conductance_WpK, 
+                                                Real source_temperature_C){
+    static const double STAGNANT_NUSSELT_NUMBER = 3.66;
+
+    if(get_mass_kg() <= 0.0 || specific_heat_capacity_JpkgC_ <= 0.0){
+        throw std::invalid_argument( "Error: Pipe mass or specific heat <= 0" );
+    }
+
+    energy_flows_ = {};
+
+    Real solar_absorbtion_W = 0.0, air_conductance_WpK = 0.0;
+    if(is_exposed_){
+        solar_absorbtion_W = environment.get_solar_irradiance_Wpm2(current_time_s) * 
+                             get_pipe_surface_area_m2(/*is_inner*/ false) * emissivity_;
+        air_conductance_WpK = get_cylinder_convective_coefficient_Wpm2K(0, environment, current_time_s) * 
+                              get_pipe_surface_area_m2(/*is_inner*/ false);
+    }
+
+    const Real mean_water_temperature_C = is_stratified() 
+                                            ? std::accumulate(layer_temperatures_C_.begin(), 
+                                                              layer_temperatures_C_.end(), Real(0.0)) / layer_temperatures_C_.size()
+                                            : water_temperature_C_;
+    const Real water_conductance_WpK = STAGNANT_NUSSELT_NUMBER * 
+                                       get_water_thermal_conductivity_WpmK(mean_water_temperature_C) / 
+                                       pipe_interior_diameter_m_ * 
+                                       get_pipe_surface_area_m2(/*is_inner*/ true);
+    const Real water_heat_capacity_JpK = get_water_mass_kg() * 
+                                         get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C);
+
+    /// Wall: relaxes toward the temperature where its heat flows balance
+    const Real ambient_temperature_C = environment.get_ambient_temperature(current_time_s);
+    const Real net_heat_W = solar_absorbtion_W + 
+                            air_conductance_WpK * (ambient_temperature_C - temperature_C_) + 
+                            water_conductance_WpK * (mean_water_temperature_C - temperature_C_) + 
+                            source_conductance_WpK * (source_temperature_C - temperature_C_);
+    const Real total_conductance_WpK = air_conductance_WpK + water_conductance_WpK + source_conductance_WpK;
+    const Real wall_temperature_change_C = net_heat_W / total_conductance_WpK * 
+                                           (1.0 - exp(-total_conductance_WpK * step_s / get_heat_capacity_JpK()));
+
+    /// Water: relaxes toward the new wall temperature
+    temperature_C_ += wall_temperature_change_C;
+    const Real water_retained = exp(-water_conductance_WpK * step_s / water_heat_capacity_JpK);
+    for(Real &layer_temperature_C : layer_temperatures_C_){
+        layer_temperature_C = temperature_C_ + (layer_temperature_C - temperature_C_) * water_retained;
+    }
+    const Real heat_transfered_to_water_J = water_heat_capacity_JpK * 
+                                            (temperature_C_ - mean_water_temperature_C) * (1.0 - water_retained);
+    water_temperature_C_ = is_stratified() 
+                            ? layer_temperatures_C_.back() 
+                            : temperature_C_ + (water_temperature_C_ - temperature_C_) * water_retained;
+    water_out_temperature_C_ = water_temperature_C_;
+
+    // Sun and water exactly, the air as whatever balances the wall (it absorbs the linearization)
+    energy_flows_.solar_absorbed_J = solar_absorbtion_W * step_s;
+    energy_flows_.transferred_to_water_J = heat_transfered_to_water_J;
+    energy_flows_.convective_loss_J = energy_flows_.solar_absorbed_J + 
+                                      source_conductance_WpK * (source_temperature_C - temperature_C_) * step_s - 
+                                      heat_transfered_to_water_J - 
+                                      get_heat_capacity_JpK() * wall_temperature_change_C;
+}
+
+// Water leaving the pipe, and the heat it took from the wall over one second, for water entering 
+// at starting_water_temperature_C while the wall is at temperature_C_
+void CylinderContainer::solve_water_outlet(Real starting_water_temperature_C, 
+                                           Real &updated_water_out_temperature_C, 
+                                           Real &heat_transfered_to_water_W){
+    static const int MAX_ITERATIONS = 25;
+    static const double TEMPURATURE_THRESHOLD_C = 0.001;
+
+    Real previous_water_out_tempurature_C = starting_water_temperature_C;
+
+    // Mean water tempurature is unknown since the tempurature out of the pipe is being calculated
+    // (3a) Initially assume the final tempurature is equal to the pipe tempurature
+    Real mean_water_temperature_C = (starting_water_temperature_C + temperature_C_) / 2;
+    Real water_heat_transfer_coefficient;
+
+    // (3b) Repeating the calculation, updating the output (and mean) tempurature each step
+    // (3c) Exit when completing MAX_ITERATIONS or when the delta between of the last calculation is 
+    //      less then TEMPURATURE_THRESHOLD_C
+    for(int iterations = 0; iterations < MAX_ITERATIONS; iterations++){
+        water_heat_transfer_coefficient = get_cylinder_convective_coefficient_Wpm2K(mean_water_temperature_C);
+        updated_water_out_temperature_C = 
+                temperature_C_ - (temperature_C_ - starting_water_temperature_C) * 
+                                    exp(((-get_pipe_surface_area_m2() * 
+                                            water_heat_transfer_coefficient) / 
+                                          (water_mass_flow_rate_kgps_ * 
+                                            get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C))
+                                        ));
+        
+        updated_water_out_temperature_C = std::clamp<Real>(updated_water_out_temperature_C, 
+                                                     min_temperature_C_, 
+                                                     max_temperature_C_);
+        mean_water_temperature_C = (starting_water_temperature_C + updated_water_out_temperature_C) / 2;
+
+        if(abs(previous_water_out_tempurature_C - updated_water_out_temperature_C) < TEMPURATURE_THRESHOLD_C ||
+           iterations == (MAX_ITERATIONS - 1)){
+            break;
+        }
+
+        previous_water_out_tempurature_C = updated_water_out_temperature_C;
+    }
+
+    heat_transfered_to_water_W = water_mass_flow_rate_kgps_ * 
+                                 get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C) * 
+                                 (updated_water_out_temperature_C - starting_water_temperature_C);
+}
+
+// Tabulates solve_water_outlet() over inlet water and wall temperatures every step_C. Water is 
+// tabulated over its allowed range; the wall over that range widened by WALL_MARGIN_C. The heat
+// transferred is held to the heat that tolerance_C of outlet temperature carries at this flow.
+void CylinderContainer::build_outlet_surrogate(double step_C, double tolerance_C){
+    static const double WALL_MARGIN_C = 50.0;
+
+    const Real wall_temperature_C = temperature_C_;
+    const double mid_temperature_C = value_of(min_temperature_C_ + max_temperature_C_) / 2;
+    const double heat_tolerance_W = tolerance_C * value_of(water_mass_flow_rate_kgps_) * 
+                                    value_of(get_water_specific_heat_capacity_JpkgC(mid_temperature_C));
+    outlet_surrogate_.build(value_of(min_temperature_C_), value_of(max_temperature_C_),
+                            value_of(min_temperature_C_) - WALL_MARGIN_C, value_of(max_temperature_C_) + WALL_MARGIN_C,
+                            step_C, tolerance_C, heat_tolerance_W,
+                            [this](double inlet_C, double wall_C, double &out_C, double &heat_W){
+                                temperature_C_ = wall_C;
+                                Real out, heat;
+                                solve_water_outlet(inlet_C, out, heat);
+                                out_C = value_of(out);
+                                heat_W = value_of(heat);
+                            });
+    temperature_C_ = wall_temperature_C;
+}
+
+void CylinderContainer::add_heat_to_water(Real total_energy_added_J) { 
+    Real water_tempurature_delta_K = total_energy_added_J / 
+                                        (get_water_specific_heat_capacity_JpkgC(water_temperature_C_) * 
+                                         get_water_mass_kg());
+    water_temperature_C_ += water_tempurature_delta_K; 
+}
+
+void CylinderContainer::set_layer_count(unsigned int layers) {
+    if(layers <= 1){
+        layer_temperatures_C_.clear();
+        return;
+    }
+    layer_temperatures_C_.assign(layers, water_temperature_C_);
+    layer_lower_.resize(layers);
+    layer_diagonal_.resize(layers);
+    layer_upper_.resize(layers);
+    layer_rhs_.resize(layers);
+}
+
+Real CylinderContainer::update_stratified_water(Real intake_water_temperature_C, double time_step_s) {
+    const size_t layer_count = layer_temperatures_C_.size();
+    const Real mean_temperature_C = std::accumulate(layer_temperatures_C_.begin(), 
+                                                      layer_temperatures_C_.end(), Real(0.0)) / layer_count;
+    const Real layer_height_m = pipe_length_m_ / layer_count;
+    const Real layer_mass_kg = get_pipe_cross_sectional_area_m2() * layer_height_m * 
+                                 get_water_density_kgpm3(mean_temperature_C);
+    const Real specific_heat_JpkgC = get_water_specific_heat_capacity_JpkgC(mean_temperature_C);
+
+    // Conductances expressed as equivalent mass flow (kg/s) so the specific heat cancels out
+    const Real conduction_kgps = get_water_thermal_conductivity_WpmK(mean_temperature_C) * 
+                                   get_pipe_cross_sectional_area_m2() / 
+                                   (layer_height_m * specific_heat_JpkgC);
+    const Real mixing_kgps = layer_mass_kg / BUOYANT_MIXING_TIME_S;
+    const Real storage_kgps = layer_mass_kg / time_step_s;
+
+    // Return water settles at the first layer (from the top) that is no warmer than itself
+    size_t inlet_layer = 0;
+    while(inlet_layer < layer_count - 1 && layer_temperatures_C_[inlet_layer] > intake_water_temperature_C){
+        inlet_layer++;
+    }
+
+    // Implicit energy balance per layer: storage + plug flow from the inlet down to the outlet,
+    // conduction between neighbours, and fast mixing wherever a lower layer is warmer than the one above
+    for(size_t i = 0; i < layer_count; i++){
+        Real above_kgps = 0.0, below_kgps = 0.0;
+        if(i > 0){
+            above_kgps = conduction_kgps + 
+                         (layer_temperatures_C_[i] > layer_temperatures_C_[i - 1] ? mixing_kgps : 0.0);
+        }
+        if(i < layer_count - 1){
+            below_kgps = conduction_kgps + 
+                         (layer_temperatures_C_[i + 1] > layer_temperatures_C_[i] ? mixing_kgps : 0.0);
+        }
+        Real through_flow_kgps = (i >= inlet_layer) ? water_mass_flow_rate_kgps_ : 0.0;
+        Real flow_from_above_kgps = (i > inlet_layer) ? water_mass_flow_rate_kgps_ : 0.0;
+
+        layer_lower_[i] = -(above_kgps + flow_from_above_kgps);
+        layer_diagonal_[i] = storage_kgps + through_flow_kgps + above_kgps + below_kgps;
+        layer_upper_[i] = -below_kgps;
+        layer_rhs_[i] = storage_kgps * layer_temperatures_C_[i] + 
+                        (i == inlet_layer ? water_mass_flow_rate_kgps_ * intake_water_temperature_C : 0.0);
+    }
+
+    solve_tridiagonal(layer_lower_, layer_diagonal_, layer_upper_, layer_rhs_);
+    layer_temperatures_C_.swap(layer_rhs_);
+
+    // Net heat carried in by the loop: return water in, bottom layer water out
+    return water_mass_flow_rate_kgps_ * specific_heat_JpkgC * time_step_s * 
+           (intake_water_temperature_C - layer_temperatures_C_.back());
+}
+
+void CylinderContainer::solve_tridiagonal(const std::vector<Real> &lower,
+                                          std::vector<Real> &diagonal,
+                                          const std::vector<Real> &upper,
+                                          std::vector<Real> &rhs) {
+    // Thomas algorithm: forward elimination then back substitution, O(n); solution is left in rhs
+    const size_t size = diagonal.size();
+    for(size_t i = 1; i < size; i++){
+        Real factor = lower[i] / diagonal[i - 1];
+        diagonal[i] -= factor * upper[i - 1];
+        rhs[i] -= factor * rhs[i - 1];
+    }
+    rhs[size - 1] /= diagonal[size - 1];
+    for(size_t i = size - 1; i-- > 0;){
+        rhs[i] = (rhs[i] - upper[i] * rhs[i + 1]) / diagonal[i];
+    }
+}
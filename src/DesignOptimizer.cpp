@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+#include "include/DesignOptimizer.hpp"
+
+DesignOptimizer::DesignOptimizer(const Simulation &simulation) : simulation_(simulation),
+                                                                 pump_power_WpKgps_(0.0),
+                                                                 panel_cost_kWhpm2pday_(0.0),
+                                                                 max_evaluations_(60),
+                                                                 checkpoints_(8),
+                                                                 tolerance_kWh_(0.001),
+                                                                 threads_(0),
+                                                                 evaluations_(0),
+                                                                 stopped_early_(0),
+                                                                 memo_hits_(0),
+                                                                 best_objective_kWh_(0.0) {}
+
+bool DesignOptimizer::read_spec(const std::string &filename)
+{
+    std::ifstream input_file(filename);
+    if (!input_file.is_open())
+    {
+        std::cerr << "Error opening input file: " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(input_file, line))
+    {
+        std::istringstream line_stream(line);
+        std::string name;
+        if (!(line_stream >> name))
+            continue;
+
+        if (name == "PARAMETER")
+        {
+            Parameter parameter = {"", 0.0, 0.0, 0.0};
+            if (!(line_stream >> parameter.name >> parameter.min >> parameter.max) || parameter.max < parameter.min)
+            {
+                std::cerr << "Error: PARAMETER needs an override name, a minimum and a maximum: " << line << std::endl;
+                return false;
+            }
+            line_stream >> parameter.resolution;
+
+            Simulation probe = simulation_;
+            if (!probe.apply_override(parameter.name, parameter.min))
+            {
+                std::cerr << "Unknown parameter: " << parameter.name << std::endl;
+                return false;
+            }
+            parameters_.push_back(parameter);
+        }
+        else if (name == "PUMP_POWER")
+            line_stream >> pump_power_WpKgps_;
+        else if (name == "PANEL_COST")
+            line_stream >> panel_cost_kWhpm2pday_;
+        else if (name == "MAX_EVALUATIONS")
+            line_stream >> max_evaluations_;
+        else if (name == "CHECKPOINTS")
+            line_stream >> checkpoints_;
+        else if (name == "TOLERANCE")
+            line_stream >> tolerance_kWh_;
+        else if (name == "THREADS")
+            line_stream >> threads_;
+        else
+            std::cerr << "Unknown parameter: " << name << std::endl;
+    }
+
+    if (parameters_.empty())
+    {
+        std::cerr << "Error: " << filename << " has no PARAMETER to optimize" << std::endl;
+        return false;
+    }
+    checkpoints_ = std::max(1u, checkpoints_);
+    return true;
+}
+
+// Override values of a scaled point, rounded to each parameter's resolution
+std::vector<double> DesignOptimizer::get_values(const Point &point) const
+{
+    std::vector<double> values;
+    for (size_t i = 0; i < parameters_.size(); i++)
+    {
+        const Parameter &parameter = parameters_[i];
+        double value = parameter.min + std::clamp(point[i], 0.0, 1.0) * (parameter.max - parameter.min);
+        if (parameter.resolution > 0.0)
+            value = parameter.min + std::round((value - parameter.min) / parameter.resolution) * parameter.resolution;
+        values.push_back(std::clamp(value, parameter.min, parameter.max));
+    }
+    return values;
+}
+
+DesignOptimizer::Evaluation DesignOptimizer::evaluate(const std::vector<double> &values, double stop_below_kWh) const
+{
+    Simulation simulation = simulation_;
+    for (size_t i = 0; i < parameters_.size(); i++)
+        simulation.apply_override(parameters_[i].name, values[i]);
+    simulation.finalize_constants();
+    const bool is_implicit = simulation.prepare_components(/*is_parareal*/ false);
+
+    const double cost_J = pump_power_WpKgps_ * value_of(simulation.get_mass_flow_rate_kgps()) * simulation.get_duration_s() +
+                          panel_cost_kWhpm2pday_ * value_of(simulation.get_panel_area_m2()) * J_PER_KWH *
+                              simulation.get_duration_s() / S_PER_DAY;
+
+    for (size_t checkpoint = 1; checkpoint < checkpoint_times_s_.size(); checkpoint++)
+    {
+        simulation.propagate(checkpoint_times_s_[checkpoint], is_implicit, nullptr);
+        if (checkpoint + 1 == checkpoint_times_s_.size())
+            break;
+
+        double bound_J = value_of(simulation.get_collected_energy_J() +
+                                  simulation.get_collection_bound_J(simulation.get_duration_s())) - cost_J;
+        if (bound_J / J_PER_KWH < stop_below_kWh)
+            return {bound_J / J_PER_KWH, false, static_cast<double>(checkpoint) / checkpoints_};
+    }
+    return {(value_of(simulation.get_collected_energy_J()) - cost_J) / J_PER_KWH, true, 1.0};
+}
+
+// Objectives of every point; new designs are simulated concurrently, known ones come from the memo.
+// Runs that cannot reach stop_below_kWh may stop early
+std::vector<double> DesignOptimizer::evaluate_all(const std::vector<Point> &points, double stop_below_kWh,
+                                                  std::ostream &report)
+{
+    std::vector<std::vector<double>> keys, pending;
+    for (const Point &point : points)
+    {
+        keys.push_back(get_values(point));
+        auto memo_iterator = memo_.find(keys.back());
+        bool is_known = memo_iterator != memo_.end() &&
+                        (memo_iterator->second.is_complete || memo_iterator->second.objective_kWh < stop_below_kWh);
+        if (is_known)
+            memo_hits_++;
+        else if (std::find(pending.begin(), pending.end(), keys.back()) == pending.end())
+            pending.push_back(keys.back());
+    }
+
+    std::vector<Evaluation> results(pending.size());
+    std::atomic<size_t> next(0);
+    auto run_pending = [&]()
+    {
+        for (size_t i = next++; i < pending.size(); i = next++)
+            results[i] = evaluate(pending[i], stop_below_kWh);
+    };
+    unsigned int threads = std::min<size_t>(threads_ > 0 ? threads_ : std::max(1u, std::thread::hardware_concurrency()),
+                                            pending.size());
+    std::vector<std::thread> workers;
+    for (unsigned int thread = 0; thread < threads; thread++)
+        workers.emplace_back(run_pending);
+    for (std::thread &worker : workers)
+        worker.join();
+
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        memo_[pending[i]] = results[i];
+        evaluations_++;
+        report << std::setw(5) << evaluations_ << " ";
+        print_values(report, pending[i]);
+        if (results[i].is_complete)
+        {
+            report << "  ->  " << std::fixed << std::setprecision(3) << results[i].objective_kWh << " kWh\n";
+        }
+        else
+        {
+            stopped_early_++;
+            report << "  ->  < " << std::fixed << std::setprecision(3) << results[i].objective_kWh << " kWh (stopped at "
+                   << std::setprecision(0) << 100.0 * results[i].stopped_at << "%)\n";
+        }
+    }
+
+    std::vector<double> objectives_kWh;
+    for (const std::vector<double> &key : keys)
+        objectives_kWh.push_back(memo_[key].objective_kWh);
+    return objectives_kWh;
+}
+
+void DesignOptimizer::print_values(std::ostream &report, const std::vector<double> &values) const
+{
+    for (size_t i = 0; i < parameters_.size(); i++)
+        report << " " << parameters_[i].name << " " << std::defaultfloat << std::setprecision(6) << values[i];
+}
+
+int DesignOptimizer::run(std::ostream &report)
+{
+    static constexpr double REFLECTION = 1.0, EXPANSION = 2.0, CONTRACTION = 0.5, SHRINK = 0.5;
+    static constexpr double INITIAL_STEP = 0.25;
+    static constexpr unsigned int MAX_ITERATIONS_PER_EVALUATION = 10; // Memo hits cost nothing, so bound the iterations too
+
+    const unsigned long duration_s = simulation_.get_duration_s();
+    checkpoint_times_s_.clear();
+    for (unsigned int checkpoint = 0; checkpoint <= checkpoints_; checkpoint++)
+        checkpoint_times_s_.push_back(duration_s * checkpoint / checkpoints_);
+
+    // Simplex around the middle of every range, largest objective first once sorted
+    const size_t dimensions = parameters_.size();
+    std::vector<Point> simplex(dimensions + 1, Point(dimensions, 0.5));
+    for (size_t i = 0; i < dimensions; i++)
+        simplex[i + 1][i] += INITIAL_STEP;
+    std::vector<double> objectives_kWh = evaluate_all(simplex, -std::numeric_limits<double>::infinity(), report);
+
+    for (unsigned int iteration = 0; iteration < MAX_ITERATIONS_PER_EVALUATION * max_evaluations_; iteration++)
+    {
+        std::vector<size_t> order(simplex.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return objectives_kWh[a] > objectives_kWh[b]; });
+        std::vector<Point> sorted_simplex;
+        std::vector<double> sorted_objectives_kWh;
+        for (size_t i : order)
+        {
+            sorted_simplex.push_back(simplex[i]);
+            sorted_objectives_kWh.push_back(objectives_kWh[i]);
+        }
+        simplex.swap(sorted_simplex);
+        objectives_kWh.swap(sorted_objectives_kWh);
+
+        const double best_kWh = objectives_kWh.front(), worst_kWh = objectives_kWh.back();
+        const double second_worst_kWh = objectives_kWh[dimensions - 1];
+        bool is_collapsed = std::all_of(simplex.begin(), simplex.end(),
+                                        [&](const Point &point){ return get_values(point) == get_values(simplex.front()); });
+        if (evaluations_ >= max_evaluations_ || best_kWh - worst_kWh <= tolerance_kWh_ || is_collapsed)
+            break;
+
+        Point centroid(dimensions, 0.0);
+        for (size_t i = 0; i < dimensions; i++)
+        {
+            for (size_t j = 0; j < dimensions; j++)
+                centroid[j] += simplex[i][j] / dimensions;
+        }
+        auto along = [&](double coefficient)
+        {
+            Point point(dimensions);
+            for (size_t j = 0; j < dimensions; j++)
+                point[j] = std::clamp(centroid[j] + coefficient * (centroid[j] - simplex.back()[j]), 0.0, 1.0);
+            return point;
+        };
+
+        std::vector<Point> candidates = {along(REFLECTION), along(EXPANSION), along(CONTRACTION), along(-CONTRACTION)};
+        std::vector<double> candidate_kWh = evaluate_all(candidates, worst_kWh, report);
+        const double reflected_kWh = candidate_kWh[0], expanded_kWh = candidate_kWh[1];
+        const double outside_kWh = candidate_kWh[2], inside_kWh = candidate_kWh[3];
+
+        size_t accepted = candidates.size();
+        if (reflected_kWh > best_kWh)
+            accepted = expanded_kWh > reflected_kWh ? 1 : 0;
+        else if (reflected_kWh > second_worst_kWh)
+            accepted = 0;
+        else if (reflected_kWh > worst_kWh && outside_kWh >= reflected_kWh)
+            accepted = 2;
+        else if (reflected_kWh <= worst_kWh && inside_kWh > worst_kWh)
+            accepted = 3;
+
+        if (accepted < candidates.size())
+        {
+            simplex.back() = candidates[accepted];
+            objectives_kWh.back() = candidate_kWh[accepted];
+            continue;
+        }
+
+        std::vector<Point> shrunk(simplex.begin() + 1, simplex.end());
+        for (Point &point : shrunk)
+        {
+            for (size_t j = 0; j < dimensions; j++)
+                point[j] = simplex.front()[j] + SHRINK * (point[j] - simplex.front()[j]);
+        }
+        std::vector<double> shrunk_kWh = evaluate_all(shrunk, -std::numeric_limits<double>::infinity(), report);
+        std::copy(shrunk.begin(), shrunk.end(), simplex.begin() + 1);
+        std::copy(shrunk_kWh.begin(), shrunk_kWh.end(), objectives_kWh.begin() + 1);
+    }
+
+    size_t best = std::max_element(objectives_kWh.begin(), objectives_kWh.end()) - objectives_kWh.begin();
+    best_objective_kWh_ = objectives_kWh[best];
+    best_values_ = get_values(simplex[best]);
+    report << "Best objective " << std::fixed << std::setprecision(3) << best_objective_kWh_ << " kWh after "
+           << evaluations_ << " simulations (" << stopped_early_ << " stopped early, " << memo_hits_
+           << " repeated designs reused). Overrides:\n";
+    for (size_t i = 0; i < parameters_.size(); i++)
+        report << parameters_[i].name << " " << std::defaultfloat << std::setprecision(6) << best_values_[i] << "\n";
+    return 0;
+}
+
+// The outcome of run() as a one row log (headers, then values), e.g. for the scenario corpus
+void DesignOptimizer::print_result(std::ostream &output) const
+{
+    output << "Simulations  Stopped early  Reused  Objective (kWh)";
+    for (const Parameter &parameter : parameters_)
+        output << "  " << parameter.name;
+    output << "\n" << evaluations_ << " " << stopped_early_ << " " << memo_hits_ << " "
+           << std::fixed << std::setprecision(3) << best_objective_kWh_;
+    for (double value : best_values_)
+        output << " " << std::defaultfloat << std::setprecision(6) << value;
+    output << "\n";
+}
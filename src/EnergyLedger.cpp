@@ -0,0 +1,82 @@
+#include "include/EnergyLedger.hpp"
+
+static const char *FLOW_NAMES[] = {"Solar", "Convective", "Radiative",
+                                   "Conducted", "To Water", "Water Input"};
+
+std::array<Real, EnergyLedger::FLOW_COUNT> EnergyLedger::to_array(const ThermodynamicObject::EnergyFlows &flows)
+{
+    return {flows.solar_absorbed_J,
+            flows.convective_loss_J,
+            flows.radiative_loss_J,
+            flows.conducted_out_J,
+            flows.transferred_to_water_J,
+            flows.water_heat_input_J};
+}
+
+size_t EnergyLedger::add_component(const std::string &name)
+{
+    components_.push_back({name, {}, {}});
+    return components_.size() - 1;
+}
+
+void EnergyLedger::record(size_t component, const ThermodynamicObject::EnergyFlows &flows)
+{
+    std::array<Real, FLOW_COUNT> values = to_array(flows);
+    ComponentAccount &account = components_[component];
+    for (int flow = 0; flow < FLOW_COUNT; flow++)
+    {
+        account.totals_J[flow].add(values[flow]);
+    }
+
+    external_net_J_.add(flows.solar_absorbed_J);
+    external_net_J_.add(-flows.convective_loss_J);
+    external_net_J_.add(-flows.radiative_loss_J);
+    water_heat_input_J_.add(flows.water_heat_input_J);
+}
+
+void EnergyLedger::print_headers(std::ofstream &output_file) const
+{
+    output_file << std::setw(10) << "Time (s)";
+    for (const ComponentAccount &account : components_)
+    {
+        for (int flow = 0; flow < FLOW_COUNT; flow++)
+        {
+            output_file << std::setw(WIDTH) << (account.name + " " + FLOW_NAMES[flow] + " (J)");
+        }
+    }
+    output_file << std::setw(WIDTH) << "Residual (J)" << "\n";
+}
+
+void EnergyLedger::print_interval_line(std::ofstream &output_file, unsigned int time_s, Real residual_J)
+{
+    output_file << std::setw(10) << time_s << std::fixed << std::setprecision(PRECISION);
+    for (ComponentAccount &account : components_)
+    {
+        for (int flow = 0; flow < FLOW_COUNT; flow++)
+        {
+            Real total_J = account.totals_J[flow].get_value();
+            output_file << std::setw(WIDTH) << total_J - account.interval_start_J[flow];
+            account.interval_start_J[flow] = total_J;
+        }
+    }
+    output_file << std::setw(WIDTH) << residual_J << "\n";
+}
+
+void EnergyLedger::print_totals(std::ofstream &output_file, Real residual_J) const
+{
+    output_file << "\nTotals (J)\n" << std::fixed << std::setprecision(PRECISION);
+    for (const ComponentAccount &account : components_)
+    {
+        for (int flow = 0; flow < FLOW_COUNT; flow++)
+        {
+            output_file << std::setw(LONG_NAME_WIDTH) << (account.name + " " + FLOW_NAMES[flow])
+                        << std::setw(WIDTH) << account.totals_J[flow].get_value() << "\n";
+        }
+    }
+    output_file << std::setw(LONG_NAME_WIDTH) << "External Net"
+                << std::setw(WIDTH) << get_external_net_J() << "\n"
+                << std::setw(LONG_NAME_WIDTH) << "Water Heat Input"
+                << std::setw(WIDTH) << get_water_heat_input_J() << "\n"
+                << std::setw(LONG_NAME_WIDTH) << "Conservation Residual"
+                << std::setw(WIDTH) << residual_J << "\n";
+}
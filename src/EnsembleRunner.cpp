@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "include/EnsembleRunner.hpp"
+
+EnsembleRunner::EnsembleRunner(const Simulation &simulation, unsigned int members, const Weather &weather)
+    : simulation_(simulation),
+      members_(members),
+      weather_(weather),
+      columns_(simulation.get_logged_columns()),
+      next_member_to_merge_(0)
+{
+    // Same lines as the regular log: time zero, then every multiple of the time step up to the duration
+    const unsigned long duration_s = simulation.get_duration_s();
+    const unsigned int time_step_s = simulation.get_time_step_s();
+    output_times_s_.push_back(0);
+    for (unsigned long time_s = time_step_s; time_step_s > 0 && time_s <= duration_s; time_s += time_step_s)
+        output_times_s_.push_back(time_s);
+
+    Sketches line_sketches;
+    for (size_t quantile = 0; quantile < QUANTILES.size(); quantile++)
+        line_sketches[quantile] = QuantileSketch(QUANTILES[quantile]);
+    sketches_.assign(output_times_s_.size() * (columns_.size() - 1), line_sketches);
+}
+
+// Every logged value (time excluded) at every output line of one member, output line major
+std::vector<double> EnsembleRunner::run_member(unsigned int member, bool is_implicit) const
+{
+    Simulation simulation = simulation_;
+    simulation.set_environment(simulation_.get_environment().get_perturbed(weather_.seed,
+                                                                           member,
+                                                                           weather_.cloud_noise,
+                                                                           weather_.wind_jitter_mps,
+                                                                           weather_.ambient_jitter_C));
+    simulation.set_current_time_s(0);
+
+    std::vector<double> values;
+    values.reserve(output_times_s_.size() * (columns_.size() - 1));
+    for (unsigned long time_s : output_times_s_)
+    {
+        simulation.propagate(time_s, is_implicit, nullptr);
+        std::vector<Simulation::LoggedColumn> columns = simulation.get_logged_columns();
+        for (size_t column = 1; column < columns.size(); column++)
+            values.push_back(columns[column].value);
+    }
+    return values;
+}
+
+void EnsembleRunner::merge(unsigned int member, const std::vector<double> &values)
+{
+    std::unique_lock<std::mutex> lock(merge_mutex_);
+    merge_turn_.wait(lock, [&]{ return next_member_to_merge_ == member; });
+
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        for (QuantileSketch &sketch : sketches_[i])
+            sketch.add(values[i]);
+    }
+
+    next_member_to_merge_++;
+    merge_turn_.notify_all();
+}
+
+void EnsembleRunner::run(std::ostream &output_file, bool is_implicit, unsigned int threads)
+{
+    threads = std::clamp(threads, 1u, members_);
+
+    std::atomic<unsigned int> next_member(0);
+    auto run_members = [&]()
+    {
+        for (unsigned int member = next_member++; member < members_; member = next_member++)
+            merge(member, run_member(member, is_implicit));
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int thread = 0; thread < threads; thread++)
+        workers.emplace_back(run_members);
+    for (std::thread &worker : workers)
+        worker.join();
+
+    output_file << std::setw(columns_[0].name_width) << columns_[0].name;
+    for (size_t column = 1; column < columns_.size(); column++)
+    {
+        for (const char *quantile_name : QUANTILE_NAMES)
+            output_file << std::setw(columns_[column].name_width + QUANTILE_NAME_WIDTH)
+                        << std::string(columns_[column].name) + quantile_name;
+    }
+    output_file << "\n";
+
+    const size_t values_per_line = columns_.size() - 1;
+    for (size_t line = 0; line < output_times_s_.size(); line++)
+    {
+        output_file << std::setw(columns_[0].value_width) << output_times_s_[line];
+        for (size_t column = 1; column < columns_.size(); column++)
+        {
+            for (const QuantileSketch &sketch : sketches_[line * values_per_line + column - 1])
+                output_file << std::setw(columns_[column].value_width + QUANTILE_NAME_WIDTH)
+                            << std::fixed << std::setprecision(columns_[column].precision) << sketch.get();
+        }
+        output_file << "\n";
+    }
+}
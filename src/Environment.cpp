@@ -1,151 +1,232 @@
-#include "include/Environment.hpp"
-
-void Environment::read_environmental_conditions(const std::string &filename)
-{
-    std::ifstream input_file(filename);
-    if (!input_file.is_open())
-    {
-        std::cerr << "Error opening input file: " << filename << std::endl;
-        return;
-    }
-
-    times_.clear();
-    solar_irradiances_.clear();
-    ambient_temperatures_.clear();
-    wind_speeds_.clear();
-
-    double time, solar_irradiance, ambient_temperature, wind_speed;
-    while (input_file >> time >> solar_irradiance >> ambient_temperature >> wind_speed)
-    {
-        times_.push_back(time);
-        solar_irradiances_.push_back(solar_irradiance);
-        ambient_temperatures_.push_back(ambient_temperature);
-        wind_speeds_.push_back(wind_speed);
-    }
-
-    input_file.close();
-}
-
-double Environment::get_solar_irradiance_Wpm2(double time) const
-{
-    return interpolate_data(time, times_, solar_irradiances_);
-}
-
-double Environment::get_ambient_temperature(double time) const
-{
-    return interpolate_data(time, times_, ambient_temperatures_);
-}
-
-double Environment::get_wind_speed(double time) const
-{
-    return interpolate_data(time, times_, wind_speeds_);
-}
-
-double Environment::get_air_density_kgpm3(double tempurature_C) const
-{
-    if (tempurature_C < -160)
-    {
-        std::cerr << "WARNING: Temperature too low to calculate air density\n";
-    }
-    else if (tempurature_C > 412)
-    {
-        std::cerr << "WARNING: Temperature too high to calculate air density\n";
-    }
-    return (2.9576e-16 * std::pow(tempurature_C, 6) -
-            3.9652642e-13 * std::pow(tempurature_C, 5) +
-            2.1718680185e-10 * std::pow(tempurature_C, 4) -
-            6.945751260987e-8 * std::pow(tempurature_C, 3) +
-            1.78311601969631e-5 * std::pow(tempurature_C, 2) -
-            4.71854397898636e-3 * tempurature_C +
-            1.29163880414105);
-}
-
-double Environment::get_air_dynamic_viscosity_kgpms(double tempurature_C) const
-{
-    if (tempurature_C < -100.0)
-    {
-        std::cerr << "WARNING: Temperature too low to calculate air thermal conductivity\n";
-    }
-    else if (tempurature_C >= 1600.0)
-    {
-        std::cerr << "WARNING: Temperature too high to calculate air thermal conductivity\n";
-    }
-    return (-2.2495e-24 * std::pow(tempurature_C, 6) +
-            1.30799548e-20 * std::pow(tempurature_C, 5) -
-            3.15320505817e-17 * std::pow(tempurature_C, 4) +
-            4.2741742090717e-14 * std::pow(tempurature_C, 3) -
-            4.09241523945073e-11 * std::pow(tempurature_C, 2) +
-            4.96170533680107e-8 * tempurature_C +
-            1.71502137925242e-5);
-}
-
-double Environment::get_air_thermal_conductivity_WpmK(double tempurature_C) const
-{ // Assumes pressure at 1 bar
-    if (tempurature_C < -190.0)
-    {
-        std::cerr << "WARNING: Temperature too low to calculate air thermal conductivity\n";
-    }
-    else if (tempurature_C >= 1600.0)
-    {
-        std::cerr << "WARNING: Temperature too high to calculate air thermal conductivity\n";
-    }
-    return (-3.75e-21 * std::pow(tempurature_C, 6) +
-            1.909230e-17 * std::pow(tempurature_C, 5) -
-            4.016396062e-14 * std::pow(tempurature_C, 4) +
-            4.901175449123e-11 * std::pow(tempurature_C, 3) -
-            4.4075614398888e-8 * std::pow(tempurature_C, 2) +
-            7.66069577308689e-5 * tempurature_C +
-            2.43560822452597e-2);
-}
-
-double Environment::get_air_specific_heat_capacity_JpkgC(double tempurature_C) const
-{ // Isobaric
-    if (tempurature_C < -160)
-    {
-        std::cerr << "WARNING: Temperature too low to calculate air specific heat capacity\n";
-    }
-    else if (tempurature_C > 1600)
-    {
-        std::cerr << "WARNING: Temperature too high to calculate air specific heat capacity\n";
-    }
-    return (-3.46607e-17 * std::pow(tempurature_C, 6) +
-            9.12184727e-14 * std::pow(tempurature_C, 5) +
-            1.079641988814e-10 * std::pow(tempurature_C, 4) -
-            5.71448440538998e-7 * std::pow(tempurature_C, 3) +
-            5.77335351056597e-4 * std::pow(tempurature_C, 2) +
-            8.97638457487819e-3 * tempurature_C +
-            1005.28623891845);
-}
-
-double Environment::interpolate_data(double time,
-                                     const std::vector<double> &data_times,
-                                     const std::vector<double> &data) const
-{
-    if (data_times.empty() || data.empty())
-        return 0.0;
-
-    if (time <= data_times.front())
-        return data.front();
-    if (time >= data_times.back())
-        return data.back();
-
-    size_t idx = 0;
-    while (idx < data_times.size() && time > data_times[idx])
-    {
-        idx++;
-    }
-
-    if (idx == 0)
-    {
-        return data[0];
-    }
-    else
-    {
-        double time1 = data_times[idx - 1];
-        double time2 = data_times[idx];
-        double x1 = data[idx - 1];
-        double x2 = data[idx];
-
-        return x1 + (x2 - x1) * (time - time1) / (time2 - time1);
-    }
-}
+#include <algorithm>
+#include <cstring>
+
+#include "include/Environment.hpp"
+
+void Environment::read_environmental_conditions(const std::string &filename)
+{
+    std::ifstream input_file(filename);
+    if (!input_file.is_open())
+    {
+        std::cerr << "Error opening input file: " << filename << std::endl;
+        return;
+    }
+
+    times_.clear();
+    solar_irradiances_.clear();
+    ambient_temperatures_.clear();
+    wind_speeds_.clear();
+
+    double time, solar_irradiance, ambient_temperature, wind_speed;
+    while (input_file >> time >> solar_irradiance >> ambient_temperature >> wind_speed)
+    {
+        times_.push_back(time);
+        solar_irradiances_.push_back(solar_irradiance);
+        ambient_temperatures_.push_back(ambient_temperature);
+        wind_speeds_.push_back(wind_speed);
+    }
+
+    input_file.close();
+}
+
+// Appends one sample after the last (e.g. rows arriving live); returns false if it is not later
+bool Environment::add_sample(double time, double solar_irradiance, double ambient_temperature, double wind_speed)
+{
+    if (!times_.empty() && time <= times_.back())
+        return false;
+
+    times_.push_back(time);
+    solar_irradiances_.push_back(solar_irradiance);
+    ambient_temperatures_.push_back(ambient_temperature);
+    wind_speeds_.push_back(wind_speed);
+    return true;
+}
+
+// Counter-based random numbers: every draw is a hash of (seed, stream, counter), so one weather
+// realization never depends on how many others were drawn before it or on which thread draws it
+static uint64_t mix_bits(uint64_t x)
+{ // SplitMix64 finalizer
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static double get_uniform(uint64_t seed, uint64_t stream, uint64_t counter)
+{ // In (0, 1)
+    uint64_t bits = mix_bits(seed ^ mix_bits(stream ^ mix_bits(counter)));
+    return ((bits >> 11) + 0.5) * 0x1.0p-53;
+}
+
+static double get_standard_normal(uint64_t seed, uint64_t stream, uint64_t counter)
+{ // Box-Muller
+    double radius = std::sqrt(-2.0 * std::log(get_uniform(seed, stream, 2 * counter)));
+    return radius * std::cos(2.0 * M_PI * get_uniform(seed, stream, 2 * counter + 1));
+}
+
+// One weather realization around this one. Every weather sample is perturbed independently (and
+// interpolated in between): irradiance is scaled by cloud cover noise (relative standard deviation
+// cloud_noise), while wind speed and ambient temperature get additive jitter. Irradiance and wind
+// never go negative. Realizations with the same seed and number are identical.
+Environment Environment::get_perturbed(uint64_t seed,
+                                       uint64_t realization,
+                                       double cloud_noise,
+                                       double wind_jitter_mps,
+                                       double ambient_jitter_C) const
+{
+    enum Draw { CLOUD, WIND, AMBIENT, DRAWS_PER_SAMPLE };
+
+    Environment perturbed = *this;
+    for (size_t i = 0; i < times_.size(); i++)
+    {
+        perturbed.solar_irradiances_[i] *= std::max(0.0, 1.0 + cloud_noise * get_standard_normal(seed, realization, i * DRAWS_PER_SAMPLE + CLOUD));
+        perturbed.wind_speeds_[i] = std::max(0.0, wind_speeds_[i] + wind_jitter_mps * get_standard_normal(seed, realization, i * DRAWS_PER_SAMPLE + WIND));
+        perturbed.ambient_temperatures_[i] += ambient_jitter_C * get_standard_normal(seed, realization, i * DRAWS_PER_SAMPLE + AMBIENT);
+    }
+    return perturbed;
+}
+
+// Hash of every sample (not of the file it came from), so equal weather gets equal hashes however
+// it was read or generated
+uint64_t Environment::get_content_hash() const
+{
+    uint64_t hash = mix_bits(times_.size());
+    for (const std::vector<double> *data : {&times_, &solar_irradiances_, &ambient_temperatures_, &wind_speeds_})
+    {
+        for (double value : *data)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            hash = mix_bits(hash ^ bits);
+        }
+    }
+    return hash;
+}
+
+// Times of the samples strictly between start_time and end_time; the weather is linear in between
+std::vector<double> Environment::get_sample_times(double start_time, double end_time) const
+{
+    auto first = std::upper_bound(times_.begin(), times_.end(), start_time);
+    auto last = std::lower_bound(first, times_.end(), end_time);
+    return std::vector<double>(first, last);
+}
+
+double Environment::get_solar_irradiance_Wpm2(double time) const
+{
+    return interpolate_data(time, times_, solar_irradiances_);
+}
+
+double Environment::get_ambient_temperature(double time) const
+{
+    return interpolate_data(time, times_, ambient_temperatures_);
+}
+
+double Environment::get_wind_speed(double time) const
+{
+    return interpolate_data(time, times_, wind_speeds_);
+}
+
+Real Environment::get_air_density_kgpm3(Real tempurature_C) const
+{
+    if (tempurature_C < -160)
+    {
+        std::cerr << "WARNING: Temperature too low to calculate air density\n";
+    }
+    else if (tempurature_C > 412)
+    {
+        std::cerr << "WARNING: Temperature too high to calculate air density\n";
+    }
+    return (2.9576e-16 * pow(tempurature_C, 6) -
+            3.9652642e-13 * pow(tempurature_C, 5) +
+            2.1718680185e-10 * pow(tempurature_C, 4) -
+            6.945751260987e-8 * pow(tempurature_C, 3) +
+            1.78311601969631e-5 * pow(tempurature_C, 2) -
+            4.71854397898636e-3 * tempurature_C +
+            1.29163880414105);
+}
+
+Real Environment::get_air_dynamic_viscosity_kgpms(Real tempurature_C) const
+{
+    if (tempurature_C < -100.0)
+    {
+        std::cerr << "WARNING: Temperature too low to calculate air thermal conductivity\n";
+    }
+    else if (tempurature_C >= 1600.0)
+    {
+        std::cerr << "WARNING: Temperature too high to calculate air thermal conductivity\n";
+    }
+    return (-2.2495e-24 * pow(tempurature_C, 6) +
+            1.30799548e-20 * pow(tempurature_C, 5) -
+            3.15320505817e-17 * pow(tempurature_C, 4) +
+            4.2741742090717e-14 * pow(tempurature_C, 3) -
+            4.09241523945073e-11 * pow(tempurature_C, 2) +
+            4.96170533680107e-8 * tempurature_C +
+            1.71502137925242e-5);
+}
+
+Real Environment::get_air_thermal_conductivity_WpmK(Real tempurature_C) const
+{ // Assumes pressure at 1 bar
+    if (tempurature_C < -190.0)
+    {
+        std::cerr << "WARNING: Temperature too low to calculate air thermal conductivity\n";
+    }
+    else if (tempurature_C >= 1600.0)
+    {
+        std::cerr << "WARNING: Temperature too high to calculate air thermal conductivity\n";
+    }
+    return (-3.75e-21 * pow(tempurature_C, 6) +
+            1.909230e-17 * pow(tempurature_C, 5) -
+            4.016396062e-14 * pow(tempurature_C, 4) +
+            4.901175449123e-11 * pow(tempurature_C, 3) -
+            4.4075614398888e-8 * pow(tempurature_C, 2) +
+            7.66069577308689e-5 * tempurature_C +
+            2.43560822452597e-2);
+}
+
+Real Environment::get_air_specific_heat_capacity_JpkgC(Real tempurature_C) const
+{ // Isobaric
+    if (tempurature_C < -160)
+    {
+        std::cerr << "WARNING: Temperature too low to calculate air specific heat capacity\n";
+    }
+    else if (tempurature_C > 1600)
+    {
+        std::cerr << "WARNING: Temperature too high to calculate air specific heat capacity\n";
+    }
+    return (-3.46607e-17 * pow(tempurature_C, 6) +
+            9.12184727e-14 * pow(tempurature_C, 5) +
+            1.079641988814e-10 * pow(tempurature_C, 4) -
+            5.71448440538998e-7 * pow(tempurature_C, 3) +
+            5.77335351056597e-4 * pow(tempurature_C, 2) +
+            8.97638457487819e-3 * tempurature_C +
+            1005.28623891845);
+}
+
+double Environment::interpolate_data(double time,
+                                     const std::vector<double> &data_times,
+                                     const std::vector<double> &data) const
+{
+    if (data_times.empty() || data.empty())
+        return 0.0;
+
+    if (time <= data_times.front())
+        return data.front();
+    if (time >= data_times.back())
+        return data.back();
+
+    // First entry at or after the requested time; binary search keeps long (e.g. yearly) weather files cheap
+    size_t idx = std::lower_bound(data_times.begin(), data_times.end(), time) - data_times.begin();
+
+    if (idx == 0)
+    {
+        return data[0];
+    }
+    else
+    {
+        double time1 = data_times[idx - 1];
+        double time2 = data_times[idx];
+        double x1 = data[idx - 1];
+        double x2 = data[idx];
+
+        return x1 + (x2 - x1) * (time - time1) / (time2 - time1);
+    }
+}
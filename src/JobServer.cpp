@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#include "include/JobServer.hpp"
+
+const JobServer::JsonValue *JobServer::JsonValue::find(const std::string &key) const
+{
+    auto iterator = std::find_if(object.rbegin(), object.rend(), [&](const auto &member){ return member.first == key; });
+    return iterator != object.rend() ? &iterator->second : nullptr;
+}
+
+namespace
+{
+class JsonParser
+{
+private:
+    static constexpr unsigned int MAX_DEPTH = 64; // Job descriptions nest two levels; keeps the recursion off the stack limit
+
+    const std::string &text_;
+    size_t position_;
+    unsigned int depth_;
+
+    void skip_whitespace()
+    {
+        while (position_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[position_])))
+            position_++;
+    }
+
+    bool consume(char expected)
+    {
+        skip_whitespace();
+        if (position_ < text_.size() && text_[position_] == expected)
+        {
+            position_++;
+            return true;
+        }
+        return false;
+    }
+
+    static int get_hex_digit(char character)
+    {
+        if (character >= '0' && character <= '9')
+            return character - '0';
+        if (character >= 'a' && character <= 'f')
+            return character - 'a' + 10;
+        if (character >= 'A' && character <= 'F')
+            return character - 'A' + 10;
+        return -1;
+    }
+
+    bool parse_string(std::string &result)
+    {
+        if (!consume('"'))
+            return false;
+        while (position_ < text_.size() && text_[position_] != '"')
+        {
+            char character = text_[position_++];
+            if (character != '\\')
+            {
+                result += character;
+                continue;
+            }
+            if (position_ >= text_.size())
+                return false;
+            char escaped = text_[position_++];
+            switch (escaped)
+            {
+            case 'n': result += '\n'; break;
+            case 't': result += '\t'; break;
+            case 'r': result += '\r'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'u': // Only ASCII is meaningful in job descriptions
+            {
+                if (position_ + 4 > text_.size())
+                    return false;
+                int code = 0;
+                for (size_t end = position_ + 4; position_ < end; position_++)
+                {
+                    int digit = get_hex_digit(text_[position_]);
+                    if (digit < 0)
+                        return false;
+                    code = code * 16 + digit;
+                }
+                result += static_cast<char>(code & 0x7F);
+                break;
+            }
+            default: result += escaped; break; // \" \\ \/
+            }
+        }
+        return consume('"');
+    }
+
+    // Length of the JSON number at the current position, 0 if there is none. strtod alone would also
+    // take nan, inf, hex and a leading '+'
+    size_t scan_number() const
+    {
+        auto is_digit = [&](size_t index) { return index < text_.size() && text_[index] >= '0' && text_[index] <= '9'; };
+        size_t end = position_;
+        if (end < text_.size() && text_[end] == '-')
+            end++;
+        if (!is_digit(end))
+            return 0;
+        if (text_[end] == '0')
+            end++;
+        while (is_digit(end))
+            end++;
+        if (end < text_.size() && text_[end] == '.')
+        {
+            if (!is_digit(++end))
+                return 0;
+            while (is_digit(end))
+                end++;
+        }
+        if (end < text_.size() && (text_[end] == 'e' || text_[end] == 'E'))
+        {
+            end++;
+            if (end < text_.size() && (text_[end] == '+' || text_[end] == '-'))
+                end++;
+            if (!is_digit(end))
+                return 0;
+            while (is_digit(end))
+                end++;
+        }
+        return end - position_;
+    }
+
+    bool parse_container(JobServer::JsonValue &value)
+    {
+        using Type = JobServer::JsonValue::Type;
+        if (text_[position_++] == '{')
+        {
+            value.type = Type::Object;
+            if (consume('}'))
+                return true;
+            do
+            {
+                std::string key;
+                if (!parse_string(key) || !consume(':'))
+                    return false;
+                value.object.emplace_back(key, JobServer::JsonValue());
+                if (!parse_value(value.object.back().second))
+                    return false;
+            } while (consume(','));
+            return consume('}');
+        }
+
+        value.type = Type::Array;
+        if (consume(']'))
+            return true;
+        do
+        {
+            value.array.emplace_back();
+            if (!parse_value(value.array.back()))
+                return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+public:
+    explicit JsonParser(const std::string &text) : text_(text), position_(0), depth_(0) {}
+
+    bool parse_value(JobServer::JsonValue &value)
+    {
+        using Type = JobServer::JsonValue::Type;
+        skip_whitespace();
+        if (position_ >= text_.size())
+            return false;
+
+        char next = text_[position_];
+        if (next == '{' || next == '[')
+        {
+            if (depth_ >= MAX_DEPTH)
+                return false;
+            depth_++;
+            bool is_parsed = parse_container(value);
+            depth_--;
+            return is_parsed;
+        }
+        if (next == '"')
+        {
+            value.type = Type::String;
+            return parse_string(value.string);
+        }
+        for (const char *literal : {"true", "false", "null"})
+        {
+            if (text_.compare(position_, std::strlen(literal), literal) == 0)
+            {
+                position_ += std::strlen(literal);
+                value.type = literal[0] == 'n' ? Type::Null : Type::Boolean;
+                value.boolean = literal[0] == 't';
+                return true;
+            }
+        }
+
+        size_t length = scan_number();
+        if (length == 0)
+            return false;
+        value.number = std::strtod(text_.substr(position_, length).c_str(), nullptr);
+        value.type = Type::Number;
+        position_ += length;
+        return true;
+    }
+
+    bool at_end()
+    {
+        skip_whitespace();
+        return position_ == text_.size();
+    }
+};
+} // namespace
+
+bool JobServer::parse_json(const std::string &text, JsonValue &value)
+{
+    JsonParser parser(text);
+    return parser.parse_value(value) && parser.at_end();
+}
+
+std::string JobServer::escape_json(const std::string &text)
+{
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char character : text)
+    {
+        switch (character)
+        {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\r': escaped += "\\r"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(character) < 0x20)
+            {
+                static const char HEX_DIGITS[] = "0123456789abcdef";
+                escaped += "\\u00";
+                escaped += HEX_DIGITS[character >> 4];
+                escaped += HEX_DIGITS[character & 0xF];
+            }
+            else
+                escaped += character;
+            break;
+        }
+    }
+    return escaped;
+}
+
+std::shared_ptr<const Environment> JobServer::get_weather(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(weather_mutex_);
+    auto cached = weather_cache_.find(filename);
+    if (cached != weather_cache_.end())
+        return cached->second;
+
+    auto environment = std::make_shared<Environment>();
+    environment->read_environmental_conditions(filename);
+    if (environment->empty())
+        return nullptr; // Not cached, so a file that appears later can still be used
+
+    weather_cache_[filename] = environment;
+    return environment;
+}
+
+std::string JobServer::run_job(const Job &job)
+{
+    std::ostringstream result;
+    result << "{\"id\": \"" << escape_json(job.id) << "\", ";
+
+    std::shared_ptr<const Environment> weather = get_weather(job.weather_filename);
+    if (!weather)
+    {
+        result << "\"status\": \"error\", \"message\": \"cannot read weather "
+               << escape_json(job.weather_filename) << "\"}";
+        return result.str();
+    }
+
+    if (!job.error.empty())
+    {
+        result << "\"status\": \"error\", \"message\": \"" << escape_json(job.error) << "\"}";
+        return result.str();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Simulation simulation;
+    simulation.set_environment(*weather);
+    for (const auto &[name, value] : job.overrides)
+    {
+        if (!simulation.apply_override(name, value))
+        {
+            result << "\"status\": \"error\", \"message\": \"unknown parameter " << escape_json(name) << "\"}";
+            return result.str();
+        }
+    }
+    simulation.finalize_constants();
+
+    std::ostringstream inline_log;
+    std::ofstream output_file;
+    if (!job.output_filename.empty())
+    {
+        output_file.open(job.output_filename);
+        if (!output_file.is_open())
+        {
+            result << "\"status\": \"error\", \"message\": \"cannot open output "
+                   << escape_json(job.output_filename) << "\"}";
+            return result.str();
+        }
+    }
+
+    try
+    {
+        if (output_file.is_open())
+            simulation.run(output_file, job.output_filename);
+        else
+            simulation.run(inline_log, "");
+    }
+    catch (const std::exception &error)
+    {
+        result << "\"status\": \"error\", \"message\": \"" << escape_json(error.what()) << "\"}";
+        return result.str();
+    }
+
+    double wall_time_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result << "\"status\": \"ok\", ";
+    if (output_file.is_open())
+        result << "\"output\": \"" << escape_json(job.output_filename) << "\", ";
+    else
+        result << "\"log\": \"" << escape_json(inline_log.str()) << "\", ";
+    result << "\"wall_time_s\": " << wall_time_s << "}";
+    return result.str();
+}
+
+void JobServer::write_result(const std::string &result_line)
+{
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    std::cout << result_line << std::endl; // Flush so the scheduler sees each result immediately
+}
+
+void JobServer::worker()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex_);
+            jobs_available_.wait(lock, [this] { return !jobs_.empty() || is_input_closed_; });
+            if (jobs_.empty())
+                return;
+            job = std::move(jobs_.front());
+            jobs_.pop();
+        }
+        write_result(run_job(job));
+    }
+}
+
+int JobServer::serve(std::istream &input, unsigned int worker_count)
+{
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < std::max(1u, worker_count); i++)
+        workers.emplace_back(&JobServer::worker, this);
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(input, line))
+    {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+
+        JsonValue description;
+        if (!parse_json(line, description) || description.type != JsonValue::Type::Object)
+        {
+            write_result("{\"id\": null, \"status\": \"error\", \"message\": \"invalid JSON on line " +
+                         std::to_string(line_number) + "\"}");
+            continue;
+        }
+
+        Job job;
+        const JsonValue *id = description.find("id");
+        job.id = id && id->type == JsonValue::Type::String ? id->string : std::to_string(line_number);
+        const JsonValue *weather = description.find("weather");
+        job.weather_filename = weather && weather->type == JsonValue::Type::String ? weather->string
+                                                                                  : "input/environment.txt";
+        const JsonValue *output = description.find("output");
+        if (output && output->type == JsonValue::Type::String)
+            job.output_filename = output->string;
+        const JsonValue *overrides = description.find("overrides");
+        if (overrides && overrides->type != JsonValue::Type::Object)
+            job.error = "overrides is not an object";
+        else if (overrides)
+        {
+            for (const auto &[name, value] : overrides->object)
+            {
+                if (value.type == JsonValue::Type::Number)
+                    job.overrides.emplace_back(name, value.number);
+                else if (value.type == JsonValue::Type::Boolean)
+                    job.overrides.emplace_back(name, value.boolean ? 1.0 : 0.0);
+                else
+                {
+                    job.error = "override " + name + " is not a number or boolean";
+                    break;
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            jobs_.push(std::move(job));
+        }
+        jobs_available_.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        is_input_closed_ = true;
+    }
+    jobs_available_.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include "include/LoopSolver.hpp"
+
+void LoopSolver::step(const Environment &environment,
+                      CylinderContainer &tank,
+                      CylinderContainer &pipe_to_panel,
+                      SolarPanel &solar_panel,
+                      CylinderContainer &pipe_on_panel,
+                      CylinderContainer &pipe_to_tank,
+                      double current_time_s,
+                      double time_step_s)
+{
+    environment_ = &environment;
+    tank_ = &tank;
+    pipe_to_panel_ = &pipe_to_panel;
+    solar_panel_ = &solar_panel;
+    pipe_on_panel_ = &pipe_on_panel;
+    pipe_to_tank_ = &pipe_to_tank;
+    end_time_s_ = current_time_s + time_step_s;
+    time_step_s_ = time_step_s;
+
+    previous_ = {tank.get_temperature(),
+                 tank.get_water_temperature_C(),
+                 pipe_to_panel.get_temperature(),
+                 solar_panel.get_temperature(),
+                 pipe_on_panel.get_temperature(),
+                 pipe_to_tank.get_temperature()};
+
+    heat_capacity_JpK_ = {tank.get_heat_capacity_JpK(),
+                          tank.get_water_mass_kg() * tank.get_water_specific_heat_capacity_JpkgC(previous_[TANK_WATER]),
+                          pipe_to_panel.get_heat_capacity_JpK(),
+                          solar_panel.get_heat_capacity_JpK(),
+                          pipe_on_panel.get_heat_capacity_JpK(),
+                          pipe_to_tank.get_heat_capacity_JpK()};
+
+    // Exchanger coefficients at the mean water temperature of the previous step
+    CylinderContainer *pipes[] = {tank_, pipe_to_panel_, pipe_on_panel_, pipe_to_tank_};
+    for (size_t i = 0; i < 4; i++)
+    {
+        Real mean_water_temperature_C = (pipes[i]->get_water_temperature_C() + pipes[i]->get_water_out_temperature_C()) / 2;
+        effectiveness_[i] = pipes[i]->get_water_effectiveness(mean_water_temperature_C);
+        capacity_rate_WpK_[i] = pipes[i]->get_mass_flow_rate_kgps() *
+                                pipes[i]->get_water_specific_heat_capacity_JpkgC(mean_water_temperature_C);
+    }
+    tank_inflow_capacity_rate_WpK_ = tank.get_mass_flow_rate_kgps() *
+                                     tank.get_water_specific_heat_capacity_JpkgC(pipe_to_tank.get_water_out_temperature_C());
+
+    if (time_step_s != factorized_time_step_s_)
+        is_factorized_ = false;
+
+    State x = previous_, residual;
+    double previous_update_C = 0.0;
+    bool is_converged = false;
+    for (int iteration = 0; iteration < MAX_ITERATIONS && !is_converged; iteration++)
+    {
+        if (!is_factorized_)
+            factorize(x);
+
+        evaluate_residual(x, residual);
+        solve_factorized(lu_, pivots_, residual);
+
+        double update_C = 0.0;
+        for (size_t i = 0; i < UNKNOWN_COUNT; i++)
+        {
+            x[i] -= residual[i];
+            update_C = std::max(update_C, std::abs(value_of(residual[i])));
+        }
+        iterations_++;
+
+        is_converged = update_C < TEMPERATURE_THRESHOLD_C;
+        if (previous_update_C > 0.0 && update_C > SLOW_CONTRACTION_RATIO * previous_update_C)
+            is_factorized_ = false;
+        previous_update_C = update_C;
+    }
+
+    if (!is_converged)
+    {
+        // The unconverged state is still applied so the run goes on; warn once, count the rest
+        if (unconverged_steps_ == 0)
+            std::cerr << "Warning: implicit loop step ending at " << end_time_s_ << " s did not converge in "
+                      << MAX_ITERATIONS << " Newton iterations (last update " << previous_update_C
+                      << " C), further ones are only counted" << std::endl;
+        unconverged_steps_++;
+        is_factorized_ = false;
+    }
+    steps_++;
+
+    apply(x);
+    record_energy_flows(x);
+}
+
+// Writes the trial temperatures (and the water leaving each component) back into the components
+void LoopSolver::apply(const State &x)
+{
+    std::array<Real, 4> outlets;
+    get_outlet_temperatures_C(x, outlets);
+
+    tank_->set_temperature(x[TANK_WALL]);
+    tank_->set_water_temperature(x[TANK_WATER]);
+    tank_->set_water_out_temperature(outlets[0]);
+    pipe_to_panel_->set_temperature(x[PIPE_TO_PANEL]);
+    pipe_to_panel_->set_water_temperature(outlets[0]);
+    pipe_to_panel_->set_water_out_temperature(outlets[1]);
+    solar_panel_->set_temperature(x[PANEL]);
+    pipe_on_panel_->set_temperature(x[PIPE_ON_PANEL]);
+    pipe_on_panel_->set_water_temperature(outlets[1]);
+    pipe_on_panel_->set_water_out_temperature(outlets[2]);
+    pipe_to_tank_->set_temperature(x[PIPE_TO_TANK]);
+    pipe_to_tank_->set_water_temperature(outlets[2]);
+    pipe_to_tank_->set_water_out_temperature(outlets[3]);
+}
+
+void LoopSolver::get_outlet_temperatures_C(const State &x, std::array<Real, 4> &outlets) const
+{
+    const Real walls[] = {x[TANK_WALL], x[PIPE_TO_PANEL], x[PIPE_ON_PANEL], x[PIPE_TO_TANK]};
+    Real inlet_C = x[TANK_WATER];
+    for (size_t i = 0; i < 4; i++)
+    {
+        outlets[i] = inlet_C + effectiveness_[i] * (walls[i] - inlet_C);
+        inlet_C = outlets[i];
+    }
+}
+
+// Energy balance of every unknown (W): storage rate less everything flowing in
+void LoopSolver::evaluate_residual(const State &x, State &residual)
+{
+    apply(x);
+
+    std::array<Real, 4> outlets;
+    get_outlet_temperatures_C(x, outlets);
+
+    for (size_t i = 0; i < UNKNOWN_COUNT; i++)
+        residual[i] = heat_capacity_JpK_[i] * (x[i] - previous_[i]) / time_step_s_;
+
+    // Wall to water along the loop
+    const Unknown walls[] = {TANK_WALL, PIPE_TO_PANEL, PIPE_ON_PANEL, PIPE_TO_TANK};
+    Real inlet_C = x[TANK_WATER];
+    for (size_t i = 0; i < 4; i++)
+    {
+        residual[walls[i]] += capacity_rate_WpK_[i] * (outlets[i] - inlet_C);
+        inlet_C = outlets[i];
+    }
+    residual[TANK_WATER] -= tank_inflow_capacity_rate_WpK_ * (outlets[3] - x[TANK_WATER]);
+
+    // Environment
+    CylinderContainer *pipes[] = {tank_, pipe_to_panel_, pipe_on_panel_, pipe_to_tank_};
+    for (size_t i = 0; i < 4; i++)
+    {
+        if (!pipes[i]->get_exposed())
+            continue;
+        Real solar_absorbtion_W, heat_transfered_to_air_W;
+        pipes[i]->get_environment_heat_flows_W(*environment_, end_time_s_, solar_absorbtion_W, heat_transfered_to_air_W);
+        residual[walls[i]] -= solar_absorbtion_W - heat_transfered_to_air_W;
+    }
+
+    SolarPanel::HeatFlows panel_flows = solar_panel_->get_heat_flows_W(*environment_, end_time_s_, *pipe_on_panel_);
+    residual[PANEL] -= panel_flows.solar_W -
+                       panel_flows.radiative_loss_W -
+                       panel_flows.conductive_loss_to_pipe_W -
+                       panel_flows.convective_loss_air_W;
+    residual[PIPE_ON_PANEL] -= panel_flows.conductive_loss_to_pipe_W;
+}
+
+// Finite difference Jacobian of the residual values, LU factorized with partial pivoting
+void LoopSolver::factorize(const State &x)
+{
+    State base_residual, residual, perturbed = x;
+    evaluate_residual(x, base_residual);
+    for (size_t j = 0; j < UNKNOWN_COUNT; j++)
+    {
+        perturbed[j] = value_of(x[j]) + JACOBIAN_STEP_C;
+        evaluate_residual(perturbed, residual);
+        for (size_t i = 0; i < UNKNOWN_COUNT; i++)
+            lu_[i][j] = value_of(residual[i] - base_residual[i]) / JACOBIAN_STEP_C;
+        perturbed[j] = x[j];
+    }
+
+    factorize_matrix(lu_, pivots_);
+
+    is_factorized_ = true;
+    factorized_time_step_s_ = time_step_s_;
+    factorizations_++;
+}
+
+// Rows are swapped whole, so the multipliers already stored below the diagonal move with their row
+// and end up in the order of the final permutation
+void LoopSolver::factorize_matrix(Matrix &lu, Pivots &pivots)
+{
+    for (size_t k = 0; k < UNKNOWN_COUNT; k++)
+    {
+        size_t pivot = k;
+        for (size_t i = k + 1; i < UNKNOWN_COUNT; i++)
+        {
+            if (std::abs(lu[i][k]) > std::abs(lu[pivot][k]))
+                pivot = i;
+        }
+        pivots[k] = pivot;
+        std::swap(lu[k], lu[pivot]);
+        for (size_t i = k + 1; i < UNKNOWN_COUNT; i++)
+        {
+            lu[i][k] /= lu[k][k];
+            for (size_t j = k + 1; j < UNKNOWN_COUNT; j++)
+                lu[i][j] -= lu[i][k] * lu[k][j];
+        }
+    }
+}
+
+// The multipliers belong to the fully permuted rows, so every row swap is applied to the right hand
+// side before the forward substitution (the order of LAPACK's getrs)
+void LoopSolver::solve_factorized(const Matrix &lu, const Pivots &pivots, State &rhs)
+{
+    for (size_t k = 0; k < UNKNOWN_COUNT; k++)
+        std::swap(rhs[k], rhs[pivots[k]]);
+    for (size_t k = 0; k < UNKNOWN_COUNT; k++)
+    {
+        for (size_t i = k + 1; i < UNKNOWN_COUNT; i++)
+            rhs[i] -= lu[i][k] * rhs[k];
+    }
+    for (size_t k = UNKNOWN_COUNT; k-- > 0;)
+    {
+        for (size_t j = k + 1; j < UNKNOWN_COUNT; j++)
+            rhs[k] -= lu[k][j] * rhs[j];
+        rhs[k] /= lu[k][k];
+    }
+}
+
+// Per component energy over the whole step (J), in the same accounts as the sequential updates
+void LoopSolver::record_energy_flows(const State &x)
+{
+    std::array<Real, 4> outlets;
+    get_outlet_temperatures_C(x, outlets);
+
+    CylinderContainer *pipes[] = {tank_, pipe_to_panel_, pipe_on_panel_, pipe_to_tank_};
+    Real inlet_C = x[TANK_WATER];
+    for (size_t i = 0; i < 4; i++)
+    {
+        ThermodynamicObject::EnergyFlows flows;
+        if (pipes[i]->get_exposed())
+        {
+            pipes[i]->get_environment_heat_flows_W(*environment_, end_time_s_, flows.solar_absorbed_J, flows.convective_loss_J);
+            flows.solar_absorbed_J *= time_step_s_;
+            flows.convective_loss_J *= time_step_s_;
+        }
+        flows.transferred_to_water_J = capacity_rate_WpK_[i] * (outlets[i] - inlet_C) * time_step_s_;
+        inlet_C = outlets[i];
+        pipes[i]->set_energy_flows(flows);
+    }
+
+    ThermodynamicObject::EnergyFlows tank_flows = tank_->get_energy_flows();
+    tank_flows.water_heat_input_J = tank_inflow_capacity_rate_WpK_ * (outlets[3] - x[TANK_WATER]) * time_step_s_;
+    tank_->set_energy_flows(tank_flows);
+
+    SolarPanel::HeatFlows panel_flows = solar_panel_->get_heat_flows_W(*environment_, end_time_s_, *pipe_on_panel_);
+    ThermodynamicObject::EnergyFlows flows;
+    flows.solar_absorbed_J = panel_flows.solar_W * time_step_s_;
+    flows.convective_loss_J = panel_flows.convective_loss_air_W * time_step_s_;
+    flows.radiative_loss_J = panel_flows.radiative_loss_W * time_step_s_;
+    flows.conducted_out_J = panel_flows.conductive_loss_to_pipe_W * time_step_s_;
+    solar_panel_->set_energy_flows(flows);
+}
+
+void LoopSolver::print_statistics(std::ostream &output) const
+{
+    output << "Implicit loop solver: " << steps_ << " steps, "
+           << iterations_ << " Newton iterations, "
+           << factorizations_ << " Jacobian factorizations";
+    if (unconverged_steps_ > 0)
+        output << ", " << unconverged_steps_ << " steps did not converge";
+    output << std::endl;
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+
+#include "include/PanelGrid.hpp"
+
+void PanelGrid::build(size_t cells,
+                      double length_m,
+                      double width_m,
+                      double thickness_m,
+                      double heat_capacity_JpKm3,
+                      double thermal_conductivity_WpmK,
+                      double pipe_length_m,
+                      double pipe_conductance_WpK,
+                      double temperature_C)
+{
+    length_cells_ = cells;
+    width_cells_ = cells;
+    stride_ = length_cells_ + 2;
+
+    const double cell_length_m = length_m / length_cells_;
+    const double cell_width_m = width_m / width_cells_;
+    cell_area_m2_ = cell_length_m * cell_width_m;
+    cell_heat_capacity_JpK_ = heat_capacity_JpKm3 * cell_area_m2_ * thickness_m;
+    length_conductance_WpK_ = thermal_conductivity_WpmK * thickness_m * cell_width_m / cell_length_m;
+    width_conductance_WpK_ = thermal_conductivity_WpmK * thickness_m * cell_length_m / cell_width_m;
+
+    temperatures_C_.assign(stride_ * (width_cells_ + 2), temperature_C);
+    next_temperatures_C_ = temperatures_C_;
+    pipe_conductance_WpK_.assign(temperatures_C_.size(), 0.0);
+
+    // Passes along the length, spread evenly across the width
+    size_t passes = std::clamp<size_t>(static_cast<size_t>(std::lround(pipe_length_m / length_m)), 1, width_cells_);
+    double cell_conductance_WpK = pipe_conductance_WpK / (passes * length_cells_);
+    for (size_t pass = 0; pass < passes; pass++)
+    {
+        size_t row = 1 + (2 * pass + 1) * width_cells_ / (2 * passes);
+        std::fill_n(pipe_conductance_WpK_.begin() + row * stride_ + 1, length_cells_, cell_conductance_WpK);
+    }
+    max_stable_step_s_ = cell_heat_capacity_JpK_ /
+                         (2 * length_conductance_WpK_ + 2 * width_conductance_WpK_ + cell_conductance_WpK);
+}
+
+// Insulated edges: every halo cell mirrors the edge cell next to it
+void PanelGrid::fill_halo()
+{
+    double *temperatures_C = temperatures_C_.data();
+    for (size_t row = 1; row <= width_cells_; row++)
+    {
+        temperatures_C[row * stride_] = temperatures_C[row * stride_ + 1];
+        temperatures_C[row * stride_ + length_cells_ + 1] = temperatures_C[row * stride_ + length_cells_];
+    }
+    std::copy_n(temperatures_C + stride_, stride_, temperatures_C);
+    std::copy_n(temperatures_C + width_cells_ * stride_, stride_, temperatures_C + (width_cells_ + 1) * stride_);
+}
+
+void PanelGrid::sweep(double step_s, const Conditions &conditions, Flows &flows)
+{
+    fill_halo();
+
+    const double ambient_K = conditions.ambient_temperature_C + 273.15;
+    const double ambient_K4 = ambient_K * ambient_K * ambient_K * ambient_K;
+    const double solar_Wpcell = conditions.irradiance_Wpm2 * cell_area_m2_;
+    const double radiation_WpK4 = STEFAN_BOLTZMANN_CONST_WPM2K4 * conditions.emissivity * cell_area_m2_;
+    const double convection_WpK = conditions.convective_coefficient_Wpm2K * cell_area_m2_;
+    const double step_per_capacity = step_s / cell_heat_capacity_JpK_;
+    const double length_conductance_WpK = length_conductance_WpK_;
+    const double width_conductance_WpK = width_conductance_WpK_;
+
+    double solar_W = 0.0, radiative_W = 0.0, convective_W = 0.0, to_pipe_W = 0.0;
+    for (size_t row = 1; row <= width_cells_; row++)
+    {
+        const double *temperatures_C = temperatures_C_.data() + row * stride_;
+        const double *above_C = temperatures_C - stride_;
+        const double *below_C = temperatures_C + stride_;
+        const double *pipe_conductance_WpK = pipe_conductance_WpK_.data() + row * stride_;
+        double *next_C = next_temperatures_C_.data() + row * stride_;
+
+#pragma omp simd reduction(+ : solar_W, radiative_W, convective_W, to_pipe_W)
+        for (size_t i = 1; i <= length_cells_; i++)
+        {
+            const double temperature_C = temperatures_C[i];
+            // Same efficiency as the lumped panel, written without branches: below the ideal
+            // temperature the drop exceeds 1 and is clamped away
+            double efficiency_drop_from_heat =
+                1.0 - conditions.efficiency_coefficient * ((temperature_C - conditions.max_ideal_temperature_C) / 100);
+            efficiency_drop_from_heat = efficiency_drop_from_heat < conditions.min_efficiency ? conditions.min_efficiency
+                                                                                              : efficiency_drop_from_heat;
+            efficiency_drop_from_heat = efficiency_drop_from_heat > 1.0 ? 1.0 : efficiency_drop_from_heat;
+            const double efficiency = conditions.ideal_efficiency * efficiency_drop_from_heat;
+            const double temperature_K = temperature_C + 273.15;
+            const double temperature_K2 = temperature_K * temperature_K;
+
+            const double cell_solar_W = solar_Wpcell * efficiency;
+            const double cell_radiative_W = radiation_WpK4 * (temperature_K2 * temperature_K2 - ambient_K4);
+            const double cell_convective_W = convection_WpK * (temperature_C - conditions.ambient_temperature_C);
+            const double cell_to_pipe_W = pipe_conductance_WpK[i] * (temperature_C - conditions.pipe_temperature_C);
+            const double lateral_W = length_conductance_WpK * (temperatures_C[i - 1] + temperatures_C[i + 1] - 2 * temperature_C) +
+                                     width_conductance_WpK * (above_C[i] + below_C[i] - 2 * temperature_C);
+
+            next_C[i] = temperature_C + step_per_capacity *
+                                            (cell_solar_W - cell_radiative_W - cell_convective_W - cell_to_pipe_W + lateral_W);
+
+            solar_W += cell_solar_W;
+            radiative_W += cell_radiative_W;
+            convective_W += cell_convective_W;
+            to_pipe_W += cell_to_pipe_W;
+        }
+    }
+    temperatures_C_.swap(next_temperatures_C_);
+
+    flows.solar_W += solar_W * step_s;
+    flows.radiative_loss_W += radiative_W * step_s;
+    flows.convective_loss_air_W += convective_W * step_s;
+    flows.conductive_loss_to_pipe_W += to_pipe_W * step_s;
+}
+
+PanelGrid::Flows PanelGrid::update(double time_step_s, const Conditions &conditions)
+{
+    static constexpr double STABILITY_MARGIN = 0.9;
+
+    // Surface losses tighten the explicit limit a little; linearize radiation at the hottest cell
+    const double hottest_K = get_max_temperature_C() + 273.15;
+    const double surface_WpK = (conditions.convective_coefficient_Wpm2K +
+                                4 * STEFAN_BOLTZMANN_CONST_WPM2K4 * conditions.emissivity * hottest_K * hottest_K * hottest_K) *
+                               cell_area_m2_;
+    const double stable_step_s = STABILITY_MARGIN /
+                                 (1.0 / max_stable_step_s_ + surface_WpK / cell_heat_capacity_JpK_);
+    const int sub_steps = std::max(1, static_cast<int>(std::ceil(time_step_s / stable_step_s)));
+
+    Flows flows;
+    for (int sub_step = 0; sub_step < sub_steps; sub_step++)
+        sweep(time_step_s / sub_steps, conditions, flows);
+
+    flows.solar_W /= time_step_s;
+    flows.radiative_loss_W /= time_step_s;
+    flows.convective_loss_air_W /= time_step_s;
+    flows.conductive_loss_to_pipe_W /= time_step_s;
+    return flows;
+}
+
+double PanelGrid::get_mean_temperature_C() const
+{
+    double sum_C = 0.0;
+    for (size_t row = 1; row <= width_cells_; row++)
+    {
+        for (size_t i = 1; i <= length_cells_; i++)
+            sum_C += temperatures_C_[row * stride_ + i];
+    }
+    return sum_C / (length_cells_ * width_cells_);
+}
+
+double PanelGrid::get_max_temperature_C() const
+{
+    double max_C = temperatures_C_[stride_ + 1];
+    for (size_t row = 1; row <= width_cells_; row++)
+    {
+        for (size_t i = 1; i <= length_cells_; i++)
+            max_C = std::max(max_C, temperatures_C_[row * stride_ + i]);
+    }
+    return max_C;
+}
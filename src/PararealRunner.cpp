@@ -0,0 +1,139 @@
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include <time.h>
+
+#include "include/PararealRunner.hpp"
+
+PararealRunner::PararealRunner(const Simulation &simulation,
+                               unsigned int slices,
+                               unsigned int coarse_step_s,
+                               double tolerance_C) : simulation_(simulation),
+                                                     coarse_(simulation),
+                                                     tolerance_C_(tolerance_C)
+{
+    coarse_.use_coarse_solver(coarse_step_s);
+
+    // Slice ends are rounded up to output lines (if any are logged); short runs get fewer slices
+    const unsigned long duration_s = simulation.get_duration_s();
+    const unsigned long output_step_s = simulation.get_time_step_s();
+    boundaries_s_.push_back(0);
+    for (unsigned int i = 1; i <= slices; i++)
+    {
+        unsigned long boundary_s = duration_s * i / slices;
+        if (output_step_s > 0)
+            boundary_s = (boundary_s + output_step_s - 1) / output_step_s * output_step_s;
+        boundary_s = std::min(boundary_s, duration_s);
+        if (boundary_s > boundaries_s_.back())
+            boundaries_s_.push_back(boundary_s);
+    }
+}
+
+// CPU time of the calling thread, so oversubscribed cores do not inflate the serial estimate
+static double get_thread_cpu_time_s()
+{
+    timespec cpu_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+    return cpu_time.tv_sec + cpu_time.tv_nsec * 1e-9;
+}
+
+PararealRunner::LoopState PararealRunner::propagate_coarse(const LoopState &start, size_t slice)
+{
+    coarse_.set_loop_state(start);
+    coarse_.set_current_time_s(boundaries_s_[slice]);
+    coarse_.propagate(boundaries_s_[slice + 1], /*is_implicit*/ true, nullptr);
+    return coarse_.get_loop_state();
+}
+
+void PararealRunner::run(std::ostream &output_file, bool is_implicit, ProgressReporter &progress_reporter)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+
+    const size_t slice_count = boundaries_s_.size() - 1;
+    std::vector<LoopState> boundary_states(slice_count + 1), coarse_states(slice_count), fine_states(slice_count);
+    std::vector<std::string> slice_logs(slice_count);
+    std::vector<double> fine_cpu_times_s(slice_count);
+    std::vector<bool> is_stale(slice_count, true); // Start moved since the last fine sweep
+
+    // Coarse prediction of every boundary
+    boundary_states[0] = simulation_.get_loop_state();
+    for (size_t n = 0; n < slice_count; n++)
+    {
+        coarse_states[n] = propagate_coarse(boundary_states[n], n);
+        boundary_states[n + 1] = coarse_states[n];
+    }
+
+    unsigned int iterations = 0;
+    double boundary_change_C = 0.0, serial_estimate_s = 0.0;
+    do
+    {
+        // Fine sweep of every slice whose start moved, all slices concurrently
+        std::vector<std::thread> workers;
+        for (size_t n = 0; n < slice_count; n++)
+        {
+            if (!is_stale[n])
+                continue;
+            workers.emplace_back([&, n]() {
+                Simulation fine = simulation_;
+                fine.set_loop_state(boundary_states[n]);
+                fine.set_current_time_s(boundaries_s_[n]);
+                std::ostringstream slice_log;
+                fine.propagate(boundaries_s_[n + 1], is_implicit, &slice_log);
+                fine_states[n] = fine.get_loop_state();
+                slice_logs[n] = slice_log.str();
+                fine_cpu_times_s[n] = get_thread_cpu_time_s();
+            });
+        }
+        for (std::thread &worker : workers)
+            worker.join();
+        if (iterations == 0)
+        {
+            for (double slice_cpu_time_s : fine_cpu_times_s)
+                serial_estimate_s += slice_cpu_time_s;
+        }
+        iterations++;
+
+        // Serial coarse correction; boundaries whose start did not move take the fine result as is.
+        // Slices before the first boundary that moved by more than the tolerance have converged
+        boundary_change_C = 0.0;
+        size_t converged_slices = slice_count;
+        std::fill(is_stale.begin(), is_stale.end(), false);
+        bool is_start_moved = false;
+        for (size_t n = 0; n < slice_count; n++)
+        {
+            LoopState coarse_state = is_start_moved ? propagate_coarse(boundary_states[n], n) : coarse_states[n];
+            LoopState corrected = fine_states[n];
+            for (size_t i = 0; i < Simulation::LOOP_STATE_SIZE; i++)
+                corrected[i] += coarse_state[i] - coarse_states[n][i];
+            coarse_states[n] = coarse_state;
+
+            is_start_moved = false;
+            double slice_change_C = 0.0;
+            for (size_t i = 0; i < Simulation::LOOP_STATE_SIZE; i++)
+            {
+                double change_C = std::abs(value_of(corrected[i] - boundary_states[n + 1][i]));
+                slice_change_C = std::max(slice_change_C, change_C);
+                is_start_moved = is_start_moved || change_C > 0.0;
+            }
+            boundary_change_C = std::max(boundary_change_C, slice_change_C);
+            if (slice_change_C > tolerance_C_ && converged_slices == slice_count)
+                converged_slices = n;
+            boundary_states[n + 1] = corrected;
+            if (n + 1 < slice_count)
+                is_stale[n + 1] = is_start_moved;
+        }
+        converged_slices = std::max<size_t>(converged_slices, std::min<size_t>(iterations, slice_count));
+        progress_reporter.on_jump(boundaries_s_[converged_slices], output_file);
+    } while (boundary_change_C > tolerance_C_ && iterations < slice_count);
+
+    for (const std::string &slice_log : slice_logs)
+        output_file << slice_log;
+
+    const double wall_time_s = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cerr << "Parareal: " << slice_count << " slices, "
+              << iterations << " iterations, last boundary change " << boundary_change_C << " °C, "
+              << wall_time_s << " s wall, " << serial_estimate_s << " s estimated serial, speedup "
+              << serial_estimate_s / wall_time_s << "x" << std::endl;
+}
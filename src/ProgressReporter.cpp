@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "include/ProgressReporter.hpp"
+
+void ProgressReporter::start(double interval_s, const std::string &metrics_filename, unsigned long duration_s)
+{
+    interval_s_ = interval_s;
+    metrics_filename_ = metrics_filename;
+    duration_s_ = duration_s;
+    ticks_until_clock_check_ = TICKS_PER_CLOCK_CHECK;
+    start_ = Clock::now();
+    next_report_ = start_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval_s));
+}
+
+void ProgressReporter::report(unsigned long simulated_s, std::ostream &output_file, bool is_done)
+{
+    Clock::time_point now = Clock::now();
+    next_report_ = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval_s_));
+
+    double wall_s = std::chrono::duration<double>(now - start_).count();
+    double speed = wall_s > 0.0 ? simulated_s / wall_s : 0.0;
+    double eta_s = speed > 0.0 ? (duration_s_ - simulated_s) / speed : 0.0;
+    double fraction = duration_s_ > 0 ? static_cast<double>(simulated_s) / duration_s_ : 1.0;
+    std::streamoff output_bytes = std::max<std::streamoff>(output_file.tellp(), 0);
+
+    if (metrics_filename_.empty())
+    {
+        std::cerr << std::fixed << std::setprecision(1)
+                  << (is_done ? "Done: " : "Progress: ") << 100.0 * fraction << "%"
+                  << " | simulated " << simulated_s << "/" << duration_s_ << " s"
+                  << " | wall " << wall_s << " s"
+                  << " | " << std::setprecision(0) << speed << " sim s/wall s"
+                  << " | ETA " << std::setprecision(1) << eta_s << " s"
+                  << " | output " << output_bytes << " bytes" << std::endl;
+        return;
+    }
+
+    // Write then rename so a scraper never reads a half written file
+    std::string temporary_filename = metrics_filename_ + ".tmp";
+    std::ofstream metrics_file(temporary_filename);
+    if (!metrics_file.is_open())
+    {
+        std::cerr << "Error opening output file: " << temporary_filename << std::endl;
+        return;
+    }
+
+    auto gauge = [&metrics_file](const char *name, const char *help, double value)
+    {
+        metrics_file << "# HELP " << name << " " << help << "\n"
+                     << "# TYPE " << name << " gauge\n"
+                     << name << " " << std::setprecision(12) << value << "\n";
+    };
+    gauge("physics_simulator_simulated_seconds", "Simulated time reached.", simulated_s);
+    gauge("physics_simulator_duration_seconds", "Simulated time requested.", duration_s_);
+    gauge("physics_simulator_wall_seconds", "Wall time since the run started.", wall_s);
+    gauge("physics_simulator_speed_ratio", "Simulated seconds per wall second.", speed);
+    gauge("physics_simulator_eta_seconds", "Estimated wall seconds remaining.", eta_s);
+    gauge("physics_simulator_output_bytes", "Bytes written to the simulation log.", output_bytes);
+    gauge("physics_simulator_done", "1 once the run has finished.", is_done ? 1.0 : 0.0);
+    metrics_file.close();
+
+    if (std::rename(temporary_filename.c_str(), metrics_filename_.c_str()) != 0)
+        std::cerr << "Error replacing output file: " << metrics_filename_ << std::endl;
+}
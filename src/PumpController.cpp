@@ -0,0 +1,57 @@
+#include "include/PumpController.hpp"
+
+bool PumpController::is_in_window(unsigned long time_s) const
+{
+    if (!has_window())
+        return true;
+
+    unsigned long time_of_day_s = time_s % SECONDS_PER_DAY;
+    if (window_start_s_ < window_end_s_)
+        return window_start_s_ <= time_of_day_s && time_of_day_s < window_end_s_;
+    return time_of_day_s >= window_start_s_ || time_of_day_s < window_end_s_; // Wraps past midnight
+}
+
+bool PumpController::update(unsigned long time_s, double panel_temperature_C, double tank_water_temperature_C)
+{
+    bool is_on = is_in_window(time_s);
+    if (is_on && is_differential_)
+    {
+        double differential_C = panel_temperature_C - tank_water_temperature_C;
+        is_on = is_on_ ? differential_C >= off_differential_C_ : differential_C >= on_differential_C_;
+    }
+
+    if (is_on != is_on_)
+        switches_++;
+    is_on_ = is_on;
+    return is_on_;
+}
+
+bool PumpController::would_switch_on(unsigned long time_s, double panel_temperature_C, double tank_water_temperature_C) const
+{
+    return is_in_window(time_s) && (!is_differential_ || panel_temperature_C - tank_water_temperature_C >= on_differential_C_);
+}
+
+unsigned long PumpController::get_seconds_to_window_open(unsigned long time_s) const
+{
+    if (is_in_window(time_s))
+        return 0;
+    return (window_start_s_ + SECONDS_PER_DAY - time_s % SECONDS_PER_DAY) % SECONDS_PER_DAY;
+}
+
+void PumpController::record_idle_step(unsigned long step_s)
+{
+    off_time_s_ += step_s;
+    idle_steps_++;
+}
+
+void PumpController::print_statistics(std::ostream &output) const
+{
+    output << "Pump control: " << switches_ << " switches, on for " << on_time_s_ << " s, off for " << off_time_s_
+           << " s in " << idle_steps_ << " idle steps" << std::endl;
+}
+
+void PumpController::print_cache_key(std::ostream &key) const
+{
+    key << is_differential_ << " " << on_differential_C_ << " " << off_differential_C_ << " "
+        << window_start_s_ << " " << window_end_s_;
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cmath>
+
+#include "include/QuantileSketch.hpp"
+
+void QuantileSketch::add(double value)
+{
+    if (count_ < EXACT_VALUES)
+    {
+        heights_[count_++] = value;
+        std::sort(heights_.begin(), heights_.begin() + count_);
+        return;
+    }
+    if (count_ == EXACT_VALUES)
+        start_markers();
+    count_++;
+
+    // Cell the value falls in; the extreme markers stretch to take it in
+    size_t cell;
+    if (value < heights_[0])
+    {
+        heights_[0] = value;
+        cell = 0;
+    }
+    else if (value >= heights_[MARKERS - 1])
+    {
+        heights_[MARKERS - 1] = value;
+        cell = MARKERS - 2;
+    }
+    else
+    {
+        cell = 0;
+        while (value >= heights_[cell + 1])
+            cell++;
+    }
+    for (size_t marker = cell + 1; marker < MARKERS; marker++)
+        positions_[marker] += 1.0;
+
+    // Move each inner marker at most one rank toward where it should be
+    const std::array<double, MARKERS> rank_fractions = get_rank_fractions();
+    for (size_t marker = 1; marker < MARKERS - 1; marker++)
+    {
+        double offset = 1.0 + (count_ - 1) * rank_fractions[marker] - positions_[marker];
+        if ((offset >= 1.0 && positions_[marker + 1] - positions_[marker] > 1.0) ||
+            (offset <= -1.0 && positions_[marker - 1] - positions_[marker] < -1.0))
+        {
+            double direction = offset > 0.0 ? 1.0 : -1.0;
+            double height = get_parabolic_height(marker, direction);
+            if (heights_[marker - 1] < height && height < heights_[marker + 1])
+                heights_[marker] = height;
+            else
+                heights_[marker] = get_linear_height(marker, direction);
+            positions_[marker] += direction;
+        }
+    }
+}
+
+std::array<double, QuantileSketch::MARKERS> QuantileSketch::get_rank_fractions() const
+{
+    return {0.0, quantile_ / 2, quantile_, (1.0 + quantile_) / 2, 1.0};
+}
+
+// Markers at the ideal ranks among the kept (sorted) values, each at least one rank apart
+void QuantileSketch::start_markers()
+{
+    const std::array<double, MARKERS> rank_fractions = get_rank_fractions();
+    std::array<double, MARKERS> heights;
+    for (size_t marker = 0; marker < MARKERS; marker++)
+    {
+        double position = std::round(1.0 + (count_ - 1) * rank_fractions[marker]);
+        if (marker > 0)
+            position = std::max(position, positions_[marker - 1] + 1.0);
+        positions_[marker] = std::min<double>(position, count_ - (MARKERS - 1 - marker));
+        heights[marker] = heights_[static_cast<size_t>(positions_[marker]) - 1];
+    }
+    std::copy(heights.begin(), heights.end(), heights_.begin());
+}
+
+double QuantileSketch::get_parabolic_height(size_t marker, double direction) const
+{
+    const double below = positions_[marker] - positions_[marker - 1];
+    const double above = positions_[marker + 1] - positions_[marker];
+    return heights_[marker] +
+           direction / (positions_[marker + 1] - positions_[marker - 1]) *
+               ((below + direction) * (heights_[marker + 1] - heights_[marker]) / above +
+                (above - direction) * (heights_[marker] - heights_[marker - 1]) / below);
+}
+
+double QuantileSketch::get_linear_height(size_t marker, double direction) const
+{
+    size_t neighbour = direction > 0.0 ? marker + 1 : marker - 1;
+    return heights_[marker] + direction * (heights_[neighbour] - heights_[marker]) /
+                                  (positions_[neighbour] - positions_[marker]);
+}
+
+double QuantileSketch::get() const
+{
+    if (count_ == 0)
+        return 0.0;
+    if (count_ > EXACT_VALUES)
+        return heights_[2];
+
+    // Few enough values to interpolate between the sorted values themselves
+    double rank = quantile_ * (count_ - 1);
+    size_t lower = static_cast<size_t>(std::floor(rank));
+    size_t upper = std::min(lower + 1, count_ - 1);
+    return heights_[lower] + (rank - lower) * (heights_[upper] - heights_[lower]);
+}
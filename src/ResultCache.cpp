@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "include/ResultCache.hpp"
+
+namespace
+{
+// Exclusive advisory lock on a file across processes for the lifetime of the object; the in process
+// mutex must already be held, since flock does not order threads sharing one process's locks
+class FileLock
+{
+private:
+    int descriptor_;
+
+public:
+    explicit FileLock(const std::filesystem::path &path)
+    {
+#ifndef _WIN32
+        descriptor_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (descriptor_ >= 0 && flock(descriptor_, LOCK_EX) != 0)
+        {
+            close(descriptor_);
+            descriptor_ = -1;
+        }
+        if (descriptor_ < 0)
+            std::cerr << "Warning: cannot lock " << path.string() << ", cache statistics may miss counts" << std::endl;
+#else
+        (void)path;
+        descriptor_ = -1;
+#endif
+    }
+
+    ~FileLock()
+    {
+#ifndef _WIN32
+        if (descriptor_ >= 0)
+            close(descriptor_); // Releases the lock
+#endif
+    }
+
+    FileLock(const FileLock &) = delete;
+    FileLock &operator=(const FileLock &) = delete;
+};
+} // namespace
+
+std::mutex ResultCache::mutex_;
+
+ResultCache::ResultCache(const std::string &directory, uintmax_t max_bytes) : directory_(directory),
+                                                                              max_bytes_(max_bytes) {}
+
+// 64-bit FNV-1a as 16 hex digits; entries store their full key, so a collision is a miss
+std::string ResultCache::get_digest(const std::string &text)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char character : text)
+    {
+        hash ^= character;
+        hash *= 0x100000001b3ULL;
+    }
+
+    std::ostringstream digest;
+    digest << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return digest.str();
+}
+
+std::filesystem::path ResultCache::get_entry_path(const std::string &key, unsigned long duration_s) const
+{
+    return directory_ / (get_digest(key) + "_" + std::to_string(duration_s) + ENTRY_EXTENSION);
+}
+
+// Entry file: "KEY <bytes>", the key, "DURATION <s>", "STATE <count> <values...>", "LOG <bytes>", the log
+bool ResultCache::read_entry(const std::filesystem::path &path, const std::string &key, Entry &entry) const
+{
+    std::ifstream entry_file(path, std::ios::binary);
+    if (!entry_file.is_open())
+        return false;
+
+    std::string label;
+    size_t key_bytes = 0, state_size = 0, log_bytes = 0;
+    if (!(entry_file >> label >> key_bytes) || label != "KEY" || key_bytes != key.size())
+        return false;
+    entry_file.get();
+    std::string stored_key(key_bytes, '\0');
+    if (!entry_file.read(stored_key.data(), key_bytes) || stored_key != key)
+        return false;
+
+    if (!(entry_file >> label >> entry.duration_s) || label != "DURATION" ||
+        !(entry_file >> label >> state_size) || label != "STATE")
+        return false;
+    entry.state.resize(state_size);
+    for (double &value : entry.state)
+    {
+        if (!(entry_file >> value))
+            return false;
+    }
+
+    if (!(entry_file >> label >> log_bytes) || label != "LOG")
+        return false;
+    entry_file.get();
+    entry.log.resize(log_bytes);
+    return static_cast<bool>(entry_file.read(entry.log.data(), log_bytes));
+}
+
+// Write then rename so no reader ever sees a half written file
+bool ResultCache::write_file(const std::filesystem::path &path, const std::string &content) const
+{
+    std::ostringstream suffix;
+    suffix << ".tmp" << std::hash<std::thread::id>{}(std::this_thread::get_id())
+           << "_" << std::chrono::steady_clock::now().time_since_epoch().count();
+    std::filesystem::path temporary_path = path;
+    temporary_path += suffix.str();
+
+    std::ofstream output_file(temporary_path, std::ios::binary);
+    if (!output_file.is_open())
+    {
+        std::cerr << "Error opening output file: " << temporary_path.string() << std::endl;
+        return false;
+    }
+    output_file << content;
+    output_file.close();
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error)
+    {
+        std::cerr << "Error replacing output file: " << path.string() << std::endl;
+        std::filesystem::remove(temporary_path, error);
+        return false;
+    }
+    return true;
+}
+
+ResultCache::Statistics ResultCache::read_statistics() const
+{
+    Statistics statistics;
+    std::ifstream statistics_file(directory_ / STATISTICS_FILENAME);
+    std::string name;
+    unsigned long count;
+    while (statistics_file >> name >> count)
+    {
+        if (name == "HITS")
+            statistics.hits = count;
+        else if (name == "MISSES")
+            statistics.misses = count;
+        else if (name == "RESUMES")
+            statistics.resumes = count;
+        else if (name == "EVICTIONS")
+            statistics.evictions = count;
+    }
+    return statistics;
+}
+
+void ResultCache::write_statistics(const Statistics &statistics) const
+{
+    std::ostringstream content;
+    content << "HITS " << statistics.hits << "\n"
+            << "MISSES " << statistics.misses << "\n"
+            << "RESUMES " << statistics.resumes << "\n"
+            << "EVICTIONS " << statistics.evictions << "\n";
+    write_file(directory_ / STATISTICS_FILENAME, content.str());
+}
+
+// Removes the least recently used entries until the cache fits in max_bytes_; returns how many
+unsigned long ResultCache::evict()
+{
+    struct CachedFile
+    {
+        std::filesystem::path path;
+        uintmax_t bytes;
+        std::filesystem::file_time_type last_used;
+    };
+
+    std::error_code error;
+    std::vector<CachedFile> files;
+    uintmax_t total_bytes = 0;
+    for (const auto &file : std::filesystem::directory_iterator(directory_, error))
+    {
+        if (file.path().extension() != ENTRY_EXTENSION)
+            continue;
+        files.push_back({file.path(), file.file_size(error), file.last_write_time(error)});
+        total_bytes += files.back().bytes;
+    }
+
+    std::sort(files.begin(), files.end(), [](const CachedFile &a, const CachedFile &b){ return a.last_used < b.last_used; });
+    unsigned long evictions = 0;
+    for (const CachedFile &file : files)
+    {
+        if (total_bytes <= max_bytes_)
+            break;
+        if (std::filesystem::remove(file.path, error))
+        {
+            total_bytes -= file.bytes;
+            evictions++;
+        }
+    }
+    return evictions;
+}
+
+bool ResultCache::find(const std::string &key, unsigned long duration_s, Entry &entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::filesystem::path path = get_entry_path(key, duration_s);
+    if (!read_entry(path, key, entry))
+        return false;
+
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+bool ResultCache::find_longest_prefix(const std::string &key, unsigned long duration_s, Entry &entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::string prefix = get_digest(key) + "_";
+
+    std::error_code error;
+    std::vector<unsigned long> durations_s;
+    for (const auto &file : std::filesystem::directory_iterator(directory_, error))
+    {
+        std::string name = file.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0 || file.path().extension() != ENTRY_EXTENSION)
+            continue;
+        unsigned long cached_duration_s = std::strtoul(name.c_str() + prefix.size(), nullptr, 10);
+        if (cached_duration_s < duration_s)
+            durations_s.push_back(cached_duration_s);
+    }
+
+    std::sort(durations_s.rbegin(), durations_s.rend());
+    for (unsigned long cached_duration_s : durations_s)
+    {
+        std::filesystem::path path = get_entry_path(key, cached_duration_s);
+        if (read_entry(path, key, entry) && !entry.state.empty())
+        {
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResultCache::store(const std::string &key, const Entry &entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+
+    std::ostringstream content;
+    content << "KEY " << key.size() << "\n" << key << "\n"
+            << "DURATION " << entry.duration_s << "\n"
+            << "STATE " << entry.state.size() << std::setprecision(17);
+    for (double value : entry.state)
+        content << " " << value;
+    content << "\nLOG " << entry.log.size() << "\n" << entry.log;
+    if (!write_file(get_entry_path(key, entry.duration_s), content.str()))
+        return;
+
+    FileLock file_lock(directory_ / LOCK_FILENAME);
+    unsigned long evictions = evict();
+    if (evictions > 0)
+    {
+        Statistics statistics = read_statistics();
+        statistics.evictions += evictions;
+        write_statistics(statistics);
+    }
+}
+
+void ResultCache::record(Outcome outcome, std::ostream &output)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+
+    FileLock file_lock(directory_ / LOCK_FILENAME);
+    Statistics statistics = read_statistics();
+    const char *outcome_name = "miss";
+    if (outcome == Outcome::HIT)
+    {
+        statistics.hits++;
+        outcome_name = "hit";
+    }
+    else if (outcome == Outcome::RESUMED)
+    {
+        statistics.resumes++;
+        outcome_name = "resumed";
+    }
+    else
+    {
+        statistics.misses++;
+    }
+    write_statistics(statistics);
+
+    output << "Result cache: " << outcome_name << " (" << statistics.hits << " hits, " << statistics.resumes
+           << " resumed, " << statistics.misses << " misses, " << statistics.evictions << " evictions so far)" << std::endl;
+}
+
+ResultCache::Statistics ResultCache::get_statistics()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return read_statistics();
+}
+
+void ResultCache::print_summary(std::ostream &output)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code error;
+    unsigned long entries = 0;
+    uintmax_t total_bytes = 0;
+    for (const auto &file : std::filesystem::directory_iterator(directory_, error))
+    {
+        if (file.path().extension() != ENTRY_EXTENSION)
+            continue;
+        entries++;
+        total_bytes += file.file_size(error);
+    }
+
+    Statistics statistics = read_statistics();
+    unsigned long lookups = statistics.hits + statistics.resumes + statistics.misses;
+    output << "Result cache " << directory_.string() << ": " << entries << " entries, " << total_bytes << " bytes\n"
+           << "  hits      " << statistics.hits << "\n"
+           << "  resumed   " << statistics.resumes << "\n"
+           << "  misses    " << statistics.misses << "\n"
+           << "  evictions " << statistics.evictions << "\n"
+           << "  hit rate  " << std::fixed << std::setprecision(1)
+           << (lookups > 0 ? 100.0 * statistics.hits / lookups : 0.0) << "%" << std::endl;
+}
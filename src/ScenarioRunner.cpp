@@ -0,0 +1,388 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "include/DesignOptimizer.hpp"
+#include "include/LoopSolver.hpp"
+#include "include/ResultCache.hpp"
+#include "include/ScenarioRunner.hpp"
+
+ScenarioRunner::ScenarioSpec ScenarioRunner::read_spec(const std::string &filename) const
+{
+    ScenarioSpec spec;
+    std::ifstream input_file(filename);
+    if (!input_file.is_open())
+    {
+        std::cerr << "Error opening input file: " << filename << std::endl;
+        return spec;
+    }
+
+    std::string line;
+    while (std::getline(input_file, line))
+    {
+        std::istringstream line_stream(line);
+        std::string name;
+        if (!(line_stream >> name))
+            continue;
+
+        if (name == "MAX_WALL_TIME_S")
+            line_stream >> spec.max_wall_time_s;
+        else if (name == "MAX_PEAK_RSS_KB")
+            line_stream >> spec.max_peak_rss_kb;
+        else if (name == "DEFAULT_TOLERANCE")
+            line_stream >> spec.default_tolerance;
+        else if (name == "COLUMN_TOLERANCE")
+        {
+            size_t column;
+            double tolerance;
+            if (line_stream >> column >> tolerance)
+                spec.column_tolerances[column] = tolerance;
+        }
+        else
+            std::cerr << "Unknown parameter: " << name << std::endl;
+    }
+    return spec;
+}
+
+// Runs the scenario once per line of cache_runs.txt ("duration [NAME value ...]", overrides on top
+// of overrides.txt) against a result cache of its own, starting empty. Each log row is one run: the
+// cache's running hit, resume, miss and eviction counts after it, and 1 if its log is identical to
+// an uncached run of the same options
+static bool run_cache_sequence(const std::string &directory, const std::string &output_filename)
+{
+    const std::string cache_directory = directory + "/cache";
+    std::error_code error;
+    std::filesystem::remove_all(cache_directory, error);
+
+    std::ifstream runs_file(directory + "/cache_runs.txt");
+    Environment environment;
+    environment.read_environmental_conditions(directory + "/environment.txt");
+
+    std::ofstream output_file(output_filename);
+    output_file << "Run  Duration (s)  Hits  Resumes  Misses  Evictions  Identical\n";
+    std::string line;
+    unsigned int run = 0;
+    while (std::getline(runs_file, line))
+    {
+        std::istringstream line_stream(line);
+        double duration_s;
+        if (!(line_stream >> duration_s))
+            continue;
+        run++;
+        std::vector<std::pair<std::string, double>> overrides = {{"SIMULATION_DURATION", duration_s}};
+        std::string name;
+        double value;
+        while (line_stream >> name >> value)
+            overrides.emplace_back(name, value);
+
+        std::string logs[2];
+        for (bool is_cached : {true, false})
+        {
+            Simulation simulation;
+            simulation.read_simulation_constants(directory + "/overrides.txt");
+            for (const auto &[override_name, override_value] : overrides)
+            {
+                if (!simulation.apply_override(override_name, override_value))
+                    return false;
+            }
+            simulation.apply_override("RESULT_CACHE", is_cached ? 1.0 : 0.0);
+            simulation.finalize_constants();
+            simulation.set_environment(environment);
+            simulation.set_result_cache_directory(cache_directory);
+
+            std::ostringstream log;
+            simulation.run(log, "");
+            logs[is_cached ? 0 : 1] = log.str();
+        }
+
+        ResultCache::Statistics statistics = ResultCache(cache_directory, 0).get_statistics();
+        output_file << run << " " << duration_s << " " << statistics.hits << " " << statistics.resumes << " "
+                    << statistics.misses << " " << statistics.evictions << " " << (logs[0] == logs[1] ? 1 : 0) << "\n";
+    }
+    std::filesystem::remove_all(cache_directory, error);
+    return true;
+}
+
+// Solves each line of linear_systems.txt (the implicit loop solver's matrix row by row, then the
+// right hand side) with the loop solver's pivoted LU factorization. Each log row is one system's
+// solution
+static bool run_linear_systems(const std::string &directory, const std::string &output_filename)
+{
+    std::ifstream systems_file(directory + "/linear_systems.txt");
+    std::ofstream output_file(output_filename);
+    output_file << "System";
+    for (size_t i = 0; i < LoopSolver::UNKNOWN_COUNT; i++)
+        output_file << "  x" << i;
+    output_file << "\n" << std::setprecision(12);
+
+    std::string line;
+    unsigned int system = 0;
+    while (std::getline(systems_file, line))
+    {
+        std::istringstream line_stream(line);
+        LoopSolver::Matrix lu;
+        LoopSolver::State rhs;
+        bool is_complete = true;
+        for (auto &row : lu)
+        {
+            for (double &value : row)
+                is_complete = is_complete && static_cast<bool>(line_stream >> value);
+        }
+        for (Real &value : rhs)
+        {
+            double rhs_value = 0.0;
+            is_complete = is_complete && static_cast<bool>(line_stream >> rhs_value);
+            value = rhs_value;
+        }
+        if (!is_complete)
+            continue;
+        system++;
+
+        LoopSolver::Pivots pivots;
+        LoopSolver::factorize_matrix(lu, pivots);
+        LoopSolver::solve_factorized(lu, pivots, rhs);
+        output_file << system;
+        for (const Real &value : rhs)
+            output_file << " " << value_of(value);
+        output_file << "\n";
+    }
+    return system > 0;
+}
+
+// Simulates the scenario, searches it if it has a design optimizer spec, replays its result cache
+// runs, or solves its linear systems; false if it cannot run
+static bool run_in_process(const std::string &directory, const std::string &output_filename)
+{
+    if (std::filesystem::exists(directory + "/cache_runs.txt"))
+        return run_cache_sequence(directory, output_filename);
+    if (std::filesystem::exists(directory + "/linear_systems.txt"))
+        return run_linear_systems(directory, output_filename);
+
+    Simulation simulation;
+    if (!std::filesystem::exists(directory + "/optimize.txt"))
+    {
+        simulation.run_simulation(directory + "/overrides.txt",
+                                  directory + "/environment.txt",
+                                  output_filename);
+        return true;
+    }
+
+    simulation.read_simulation_constants(directory + "/overrides.txt");
+    Environment environment;
+    environment.read_environmental_conditions(directory + "/environment.txt");
+    simulation.set_environment(environment);
+
+    DesignOptimizer optimizer(simulation);
+    if (!optimizer.read_spec(directory + "/optimize.txt"))
+        return false;
+    std::ostringstream report;
+    optimizer.run(report);
+    std::ofstream output_file(output_filename);
+    optimizer.print_result(output_file);
+    return true;
+}
+
+ScenarioRunner::RunResult ScenarioRunner::run_scenario(const std::string &directory,
+                                                       const std::string &output_filename) const
+{
+    RunResult result;
+    auto start = std::chrono::steady_clock::now();
+
+#ifndef _WIN32
+    // Each scenario runs in its own process so that its peak RSS is measured in isolation
+    std::cout.flush(); // Otherwise the child can flush a copy of pending report lines
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Out of range warnings are part of some scenarios; keep the report readable
+        if (!std::freopen("/dev/null", "w", stderr))
+            _exit(2);
+        _exit(run_in_process(directory, output_filename) ? 0 : 1);
+    }
+    if (pid < 0)
+    {
+        std::cerr << "Error starting scenario: " << directory << std::endl;
+        return result;
+    }
+
+    int status = 0;
+    struct rusage usage = {};
+    wait4(pid, &status, 0, &usage);
+    result.completed = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    result.peak_rss_kb = usage.ru_maxrss;
+#else
+    result.completed = run_in_process(directory, output_filename);
+#endif
+
+    result.wall_time_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static std::vector<std::vector<std::string>> read_log_rows(const std::string &filename)
+{
+    std::vector<std::vector<std::string>> rows;
+    std::ifstream input_file(filename);
+    std::string line;
+    std::getline(input_file, line); // Headers
+    while (std::getline(input_file, line))
+    {
+        std::istringstream line_stream(line);
+        std::vector<std::string> row;
+        std::string cell;
+        while (line_stream >> cell)
+            row.push_back(cell);
+        if (!row.empty())
+            rows.push_back(row);
+    }
+    return rows;
+}
+
+// A whole cell as a number; false for truncated or malformed cells, which fail only their scenario
+static bool parse_cell(const std::string &cell, double &value)
+{
+    char *end = nullptr;
+    value = std::strtod(cell.c_str(), &end);
+    return end != cell.c_str() && *end == '\0';
+}
+
+ScenarioRunner::Comparison ScenarioRunner::compare_logs(const std::string &expected_filename,
+                                                        const std::string &actual_filename,
+                                                        const ScenarioSpec &spec) const
+{
+    Comparison comparison;
+    std::vector<std::vector<std::string>> expected = read_log_rows(expected_filename);
+    std::vector<std::vector<std::string>> actual = read_log_rows(actual_filename);
+
+    if (expected.empty())
+    {
+        comparison.message = "missing golden output " + expected_filename;
+        return comparison;
+    }
+    if (expected.size() != actual.size())
+    {
+        comparison.message = "expected " + std::to_string(expected.size()) + " rows, got " +
+                             std::to_string(actual.size());
+        return comparison;
+    }
+
+    std::ostringstream message;
+    for (size_t row = 0; row < expected.size(); row++)
+    {
+        if (expected[row].size() != actual[row].size())
+        {
+            comparison.message = "column count differs at row " + std::to_string(row);
+            return comparison;
+        }
+        for (size_t column = 0; column < expected[row].size(); column++)
+        {
+            auto tolerance_iterator = spec.column_tolerances.find(column);
+            double tolerance = tolerance_iterator != spec.column_tolerances.end() ? tolerance_iterator->second
+                                                                                   : spec.default_tolerance;
+            double expected_value, actual_value;
+            if (!parse_cell(expected[row][column], expected_value) || !parse_cell(actual[row][column], actual_value))
+            {
+                comparison.message = "malformed value at row " + std::to_string(row) + " column " + std::to_string(column) +
+                                     ": expected \"" + expected[row][column] + "\", got \"" + actual[row][column] + "\"";
+                return comparison;
+            }
+            double deviation = std::abs(expected_value - actual_value);
+            double tolerance_use = tolerance > 0.0 ? deviation / tolerance : (deviation > 0.0 ? HUGE_VAL : 0.0);
+
+            if (tolerance_use > comparison.worst_tolerance_use)
+            {
+                comparison.worst_tolerance_use = tolerance_use;
+                message.str("");
+                message << "worst deviation " << deviation << " at row " << row << " column " << column
+                        << " (tolerance " << tolerance << ")";
+            }
+        }
+    }
+
+    comparison.matches = comparison.worst_tolerance_use <= 1.0;
+    comparison.message = comparison.worst_tolerance_use > 0.0 ? message.str() : "exact match";
+    return comparison;
+}
+
+int ScenarioRunner::run_all(const std::string &corpus_directory, const std::string &name_filter, bool record_golden)
+{
+    std::vector<std::string> directories;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(corpus_directory, error))
+    {
+        std::string name = entry.path().filename().string();
+        if (entry.is_directory() && name.find(name_filter) != std::string::npos)
+            directories.push_back(entry.path().string());
+    }
+    if (error)
+    {
+        std::cerr << "Error opening scenario directory: " << corpus_directory << std::endl;
+        return 1;
+    }
+    std::sort(directories.begin(), directories.end());
+
+    int failures = 0;
+    for (const std::string &directory : directories)
+    {
+        std::string name = std::filesystem::path(directory).filename().string();
+        ScenarioSpec spec = read_spec(directory + "/scenario.txt");
+        std::string expected_filename = directory + "/expected_log.txt";
+        std::string output_filename = record_golden ? expected_filename : directory + "/actual_log.txt";
+
+        RunResult run = run_scenario(directory, output_filename);
+        Comparison comparison;
+        if (record_golden)
+        {
+            comparison.matches = run.completed;
+            comparison.message = "recorded golden output";
+        }
+        else if (run.completed)
+        {
+            comparison = compare_logs(expected_filename, output_filename, spec);
+
+            // Side outputs share the default tolerance; column indices only refer to the main log
+            ScenarioSpec side_spec = spec;
+            side_spec.column_tolerances.clear();
+            for (const char *suffix : SIDE_OUTPUT_SUFFIXES)
+            {
+                std::string expected_side_filename = directory + "/expected_log" + suffix;
+                if (!comparison.matches || !std::filesystem::exists(expected_side_filename))
+                    continue;
+                Comparison side = compare_logs(expected_side_filename, directory + "/actual_log" + suffix, side_spec);
+                if (!side.matches || side.worst_tolerance_use > comparison.worst_tolerance_use)
+                {
+                    side.message = std::string(suffix) + " " + side.message;
+                    comparison = side;
+                }
+            }
+        }
+        else
+        {
+            comparison.message = "simulation did not complete";
+        }
+
+        bool within_time = run.wall_time_s <= spec.max_wall_time_s;
+        bool within_memory = run.peak_rss_kb <= spec.max_peak_rss_kb;
+        bool passed = comparison.matches && within_time && within_memory;
+        if (!passed)
+            failures++;
+
+        std::cout << (passed ? "PASS " : "FAIL ") << std::left << std::setw(NAME_WIDTH) << name << std::right
+                  << std::fixed << std::setprecision(2)
+                  << " output " << std::setw(6) << 100.0 * comparison.worst_tolerance_use << "% of tolerance"
+                  << "  time " << std::setw(8) << run.wall_time_s << "/" << spec.max_wall_time_s << " s ("
+                  << std::setprecision(0) << 100.0 * run.wall_time_s / spec.max_wall_time_s << "%)"
+                  << "  RSS " << run.peak_rss_kb << "/" << spec.max_peak_rss_kb << " KB ("
+                  << 100.0 * run.peak_rss_kb / spec.max_peak_rss_kb << "%)"
+                  << "  " << comparison.message << "\n";
+    }
+
+    std::cout << directories.size() - failures << "/" << directories.size() << " scenarios passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -1,224 +1,1009 @@
-
-#include <functional>
-#include <unordered_set>
-#include <unordered_map>
-
-#include "include/Simulation.hpp"
-
-void Simulation::print_headers(std::ofstream &output_file)
-{
-    output_file << std::setw(FIRST_WIDTH) << "Time (s)"
-                << std::setw(SHORT_WIDTH) << "Ambient (°C)"
-                << std::setw(SHORT_WIDTH) << "Wind (m/s)"
-                << std::setw(MEDIUM_WIDTH) << "Irradiance (W/m^2)"
-                << std::setw(SHORT_WIDTH) << "Tank (°C)"
-                << std::setw(LONG_WIDTH) << "Water (Tank) (°C)"
-                << std::setw(LONG_WIDTH) << "Pipe (To Panel) (°C)"
-                << std::setw(LONG_WIDTH) << "Water (To Panel) (°C)"
-                << std::setw(LONG_WIDTH) << "Solar Panel (°C)"
-                << std::setw(LONG_WIDTH) << "Pipe (Panel) (°C)"
-                << std::setw(LONG_WIDTH) << "Water (Panel) (°C)"
-                << std::setw(LONG_WIDTH) << "Pipe (To Tank) (°C)"
-                << std::setw(LONG_WIDTH) << "Water (To Tank) (°C)"
-                << "\n";
-}
-
-void Simulation::print_data_line(std::ofstream &output_file)
-{
-    const double solar_irradiance = environment_.get_solar_irradiance_Wpm2(current_time_s_);
-    const double ambient_temperature = environment_.get_ambient_temperature(current_time_s_);
-    const double wind_speed = environment_.get_wind_speed(current_time_s_);
-
-    output_file << std::setw(FIRST_WIDTH) << current_time_s_
-                << std::setw(SHORT_WIDTH - 1) 
-                << std::fixed << std::setprecision(PRECISION) << ambient_temperature
-                << std::setw(SHORT_WIDTH)     
-                << std::fixed << std::setprecision(PRECISION) << wind_speed
-                << std::setw(MEDIUM_WIDTH)    
-                << std::fixed << std::setprecision(PRECISION) << solar_irradiance
-                << std::setw(SHORT_WIDTH - 1) 
-                << std::fixed << std::setprecision(PRECISION) << tank_.get_temperature()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << tank_.get_water_out_temperature_C()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << pipe_into_panel_.get_temperature()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << pipe_into_panel_.get_water_out_temperature_C()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << solar_panel_.get_temperature()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << pipe_on_panel_.get_temperature()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << pipe_on_panel_.get_water_out_temperature_C()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << pipe_into_tank_.get_temperature()
-                << std::setw(LONG_WIDTH - 1)  
-                << std::fixed << std::setprecision(PRECISION) << pipe_into_tank_.get_water_out_temperature_C()
-                << "\n";
-}
-
-// Function to read simulation constants from input file
-void Simulation::read_simulation_constants(const std::string &filename)
-{
-    std::ifstream inputFile(filename);
-    if (!inputFile.is_open())
-    {
-        std::cerr << "Error opening input file: " << filename << std::endl;
-        return;
-    }
-
-    std::string paramName;
-    double paramValue;
-    std::unordered_set<std::string> updated_parameters;
-    static const std::unordered_map<std::string, std::function<void(double)>> parameterMap = {
-        {"SIMULATION_DURATION",	        [this](double value){ duration_s_ = static_cast<unsigned long>(value); }},
-        {"SIMULATION_TIME_STEP",	    [this](double value){ time_step_s_ = static_cast<unsigned int>(value); }},
-
-        {"PANEL_WIDTH",	                [this](double value){ solar_panel_.set_wdith(value); }},
-        {"PANEL_LENGTH",	            [this](double value){ solar_panel_.set_length(value); }},
-        {"PANEL_TEMPERATURE",	        [this](double value){ solar_panel_.set_temperature(value); }},
-        {"PANEL_HEAT_CAPACITY",	        [this](double value){ solar_panel_.set_specific_heat_capacity(value); }},
-        {"PANEL_IDEAL_EFFICIENCY",	    [this](double value){ solar_panel_.set_ideal_efficiency(value); }},
-        {"PANEL_EMISSIVITY",	        [this](double value){ solar_panel_.set_emissivity(value); }},
-        {"PANEL_THICKNESS",	            [this](double value){ solar_panel_.set_thickness(value); }},
-        {"PANEL_EFFICIENCY_COEFFICIENT",[this](double value){ solar_panel_.set_efficiency_coefficient(value); }},
-
-        {"MASS_FLOW_RATE",              [this](double value){ tank_.set_mass_flow_rate(value);
-                                                              pipe_into_tank_.set_mass_flow_rate(value); 
-                                                              pipe_into_panel_.set_mass_flow_rate(value); 
-                                                              pipe_on_panel_.set_mass_flow_rate(value); }},
-        {"WATER_MAX_TEMPERATURE",	    [this](double value){ tank_.set_max_temperature(value);
-                                                              pipe_into_tank_.set_max_temperature(value);
-                                                              pipe_into_panel_.set_max_temperature(value); 
-                                                              pipe_on_panel_.set_max_temperature(value); }},
-        {"WATER_MIN_TEMPERATURE",	    [this](double value){ tank_.set_min_temperature(value);
-                                                              pipe_into_tank_.set_min_temperature(value);
-                                                              pipe_into_panel_.set_min_temperature(value); 
-                                                              pipe_on_panel_.set_min_temperature(value); }},
-
-        {"TANK_WALL_TEMPERATURE",	    [this](double value){ tank_.set_temperature(value); }},
-        {"TANK_WATER_TEMPERATURE",	    [this](double value){ tank_.set_water_temperature(value); }},
-        {"TANK_HEAT_CAPACITY",	        [this](double value){ tank_.set_specific_heat_capacity(value); }},
-        {"TANK_EMISSIVITY",	            [this](double value){ tank_.set_emissivity(value); }},
-        {"TANK_THICKNESS",	            [this](double value){ tank_.set_thickness(value); }},
-        {"TANK_MASS_FLOW_RATE",	        [this](double value){ tank_.set_mass_flow_rate(value); }},
-        {"TANK_EXPOSED",	            [this](double value){ tank_.set_exposed(static_cast<bool>(value)); }},
-        {"TANK_PIPE_LENGTH",	        [this](double value){ tank_.set_pipe_length(value); }},
-        {"TANK_MAX_TEMPERATURE",	    [this](double value){ tank_.set_max_temperature(value); }},
-        {"TANK_MIN_TEMPERATURE",	    [this](double value){ tank_.set_min_temperature(value); }},
-        {"TANK_INTERIOR_DIAMETER",	    [this](double value){ tank_.set_pipe_interior_diameter(value); }},
-
-        {"PIPE2TANK_WALL_TEMPERATURE",	[this](double value){ pipe_into_tank_.set_temperature(value); }},
-        {"PIPE2TANK_WATER_TEMPERATURE",	[this](double value){ pipe_into_tank_.set_water_temperature(value); }},
-        {"PIPE2TANK_HEAT_CAPACITY",	    [this](double value){ pipe_into_tank_.set_specific_heat_capacity(value); }},
-        {"PIPE2TANK_EMISSIVITY",	    [this](double value){ pipe_into_tank_.set_emissivity(value); }},
-        {"PIPE2TANK_THICKNESS",	        [this](double value){ pipe_into_tank_.set_thickness(value); }},
-        {"PIPE2TANK_MASS_FLOW_RATE",	[this](double value){ pipe_into_tank_.set_mass_flow_rate(value); }},
-        {"PIPE2TANK_EXPOSED",	        [this](double value){ pipe_into_tank_.set_exposed(static_cast<bool>(value)); }},
-        {"PIPE2TANK_PIPE_LENGTH",	    [this](double value){ pipe_into_tank_.set_pipe_length(value); }},
-        {"PIPE2TANK_MAX_TEMPERATURE",	[this](double value){ pipe_into_tank_.set_max_temperature(value); }},
-        {"PIPE2TANK_MIN_TEMPERATURE",	[this](double value){ pipe_into_tank_.set_min_temperature(value); }},
-        {"PIPE2TANK_INTERIOR_DIAMETER",	[this](double value){ pipe_into_tank_.set_pipe_interior_diameter(value); }},
-
-        {"PIPE2PANEL_WALL_TEMPERATURE",	[this](double value){ pipe_into_panel_.set_temperature(value); }},
-        {"PIPE2PANEL_WATER_TEMPERATURE",[this](double value){ pipe_into_panel_.set_water_temperature(value); }},
-        {"PIPE2PANEL_HEAT_CAPACITY",	[this](double value){ pipe_into_panel_.set_specific_heat_capacity(value); }},
-        {"PIPE2PANEL_EMISSIVITY",	    [this](double value){ pipe_into_panel_.set_emissivity(value); }},
-        {"PIPE2PANEL_THICKNESS",	    [this](double value){ pipe_into_panel_.set_thickness(value); }},
-        {"PIPE2PANEL_MASS_FLOW_RATE",	[this](double value){ pipe_into_panel_.set_mass_flow_rate(value); }},
-        {"PIPE2PANEL_EXPOSED",	        [this](double value){ pipe_into_panel_.set_exposed(static_cast<bool>(value)); }},
-        {"PIPE2PANEL_PIPE_LENGTH",	    [this](double value){ pipe_into_panel_.set_pipe_length(value); }},
-        {"PIPE2PANEL_MAX_TEMPERATURE",	[this](double value){ pipe_into_panel_.set_max_temperature(value); }},
-        {"PIPE2PANEL_MIN_TEMPERATURE",	[this](double value){ pipe_into_panel_.set_min_temperature(value); }},
-        {"PIPE2PANEL_INTERIOR_DIAMETER",[this](double value){ pipe_into_panel_.set_pipe_interior_diameter(value); }},
-
-        {"PIPE_PANEL_WALL_TEMPERATURE",	[this](double value){ pipe_on_panel_.set_temperature(value); }},
-        {"PIPE_PANEL_WATER_TEMPERATURE",[this](double value){ pipe_on_panel_.set_water_temperature(value); }},
-        {"PIPE_PANEL_HEAT_CAPACITY",	[this](double value){ pipe_on_panel_.set_specific_heat_capacity(value); }},
-        {"PIPE_PANEL_EMISSIVITY",	    [this](double value){ pipe_on_panel_.set_emissivity(value); }},
-        {"PIPE_PANEL_THICKNESS",	    [this](double value){ pipe_on_panel_.set_thickness(value); }},
-        {"PIPE_PANEL_MASS_FLOW_RATE",	[this](double value){ pipe_on_panel_.set_mass_flow_rate(value); }},
-        {"PIPE_PANEL_EXPOSED",	        [this](double value){ pipe_on_panel_.set_exposed(static_cast<bool>(value)); }},
-        {"PIPE_PANEL_PIPE_LENGTH",	    [this](double value){ pipe_on_panel_.set_pipe_length(value); }},
-        {"PIPE_PANEL_MAX_TEMPERATURE",	[this](double value){ pipe_on_panel_.set_max_temperature(value); }},
-        {"PIPE_PANEL_MIN_TEMPERATURE",	[this](double value){ pipe_on_panel_.set_min_temperature(value); }},
-        {"PIPE_PANEL_INTERIOR_DIAMETER",[this](double value){ pipe_on_panel_.set_pipe_interior_diameter(value); }}};
-
-    while (inputFile >> paramName >> paramValue)
-    {
-        if (updated_parameters.count(paramName))
-        {
-            std::cerr << "Warning: " << filename << " contains multiple overrides for " 
-                      << paramName << std::endl;
-        }
-        else
-        {
-            updated_parameters.insert(paramName);
-        }
-
-        auto parameter_iterator = parameterMap.find(paramName);
-        if (parameter_iterator != parameterMap.end())
-        {
-            parameter_iterator->second(paramValue);
-        }
-        else
-        {
-            std::cerr << "Unknown parameter: " << paramName << std::endl;
-        }
-    }
-
-    double solar_panel_pipe_length_m = solar_panel_.get_surface_area_m2() *
-                                       solar_panel_.get_pipe_contact_percentage() /
-                                       pipe_on_panel_.get_pipe_interior_diameter_m();
-    pipe_on_panel_.set_pipe_length(solar_panel_pipe_length_m);
-
-    inputFile.close();
-}
-
-void Simulation::run_simulation(const std::string &sim_overrides_file,
-                                const std::string &environmental_file,
-                                const std::string &output_filename)
-{
-
-    static constexpr int ONE_SECOND = 1;
-
-    read_simulation_constants(sim_overrides_file);
-    environment_.read_environmental_conditions(environmental_file);
-
-    std::ofstream output_file(output_filename);
-    if (!output_file.is_open())
-    {
-        std::cerr << "Error opening output file: " << output_filename << std::endl;
-        return;
-    }
-
-    print_headers(output_file);
-    print_data_line(output_file);
-
-    current_time_s_ = 0.0;
-    while (current_time_s_ <= duration_s_ - 1)
-    {
-        tank_.one_second_update_temperature(pipe_into_tank_.get_water_out_temperature_C(),
-                                            environment_,
-                                            current_time_s_);
-        pipe_into_panel_.one_second_update_temperature(tank_.get_water_out_temperature_C(),
-                                                       environment_,
-                                                       current_time_s_);
-        solar_panel_.one_second_update_temperature(pipe_into_panel_.get_water_out_temperature_C(),
-                                                   environment_,
-                                                   current_time_s_,
-                                                   pipe_on_panel_);
-        pipe_into_tank_.one_second_update_temperature(pipe_on_panel_.get_water_out_temperature_C(),
-                                                      environment_,
-                                                      current_time_s_);
-
-        current_time_s_ += ONE_SECOND;
-
-        if (std::fmod(current_time_s_, time_step_s_) != 0)
-            continue;
-
-        print_data_line(output_file);
-    }
-
-    output_file.close();
-}
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <unordered_set>
+#include <unordered_map>
+
+#include "include/EnsembleRunner.hpp"
+#include "include/PararealRunner.hpp"
+#include "include/ResultCache.hpp"
+#include "include/SpscQueue.hpp"
+#include "include/StreamRunner.hpp"
+
+// Every logged quantity at the current time, in log order. Value widths are one less than the name
+// widths for names containing the two byte '°', so values line up under their names
+std::vector<Simulation::LoggedColumn> Simulation::get_logged_columns() const
+{
+    std::vector<LoggedColumn> columns = {
+        {"Time (s)",              FIRST_WIDTH,  FIRST_WIDTH,      0,         static_cast<double>(current_time_s_)},
+        {"Ambient (°C)",          SHORT_WIDTH,  SHORT_WIDTH - 1,  PRECISION, environment_.get_ambient_temperature(current_time_s_)},
+        {"Wind (m/s)",            SHORT_WIDTH,  SHORT_WIDTH,      PRECISION, environment_.get_wind_speed(current_time_s_)},
+        {"Irradiance (W/m^2)",    MEDIUM_WIDTH, MEDIUM_WIDTH,     PRECISION, environment_.get_solar_irradiance_Wpm2(current_time_s_)},
+        {"Tank (°C)",             SHORT_WIDTH,  SHORT_WIDTH - 1,  PRECISION, value_of(tank_.get_temperature())},
+        {"Water (Tank) (°C)",     LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(tank_.get_water_out_temperature_C())},
+        {"Pipe (To Panel) (°C)",  LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(pipe_into_panel_.get_temperature())},
+        {"Water (To Panel) (°C)", LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(pipe_into_panel_.get_water_out_temperature_C())},
+        {"Solar Panel (°C)",      LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(solar_panel_.get_temperature())},
+        {"Pipe (Panel) (°C)",     LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(pipe_on_panel_.get_temperature())},
+        {"Water (Panel) (°C)",    LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(pipe_on_panel_.get_water_out_temperature_C())},
+        {"Pipe (To Tank) (°C)",   LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(pipe_into_tank_.get_temperature())},
+        {"Water (To Tank) (°C)",  LONG_WIDTH,   LONG_WIDTH - 1,   PRECISION, value_of(pipe_into_tank_.get_water_out_temperature_C())}};
+    if (tank_.is_stratified())
+        columns.push_back({"Water (Tank Top) (°C)", LONG_WIDTH, LONG_WIDTH - 1, PRECISION, value_of(tank_.get_top_layer_temperature_C())});
+    if (solar_panel_.has_grid())
+        columns.push_back({"Solar Panel Max (°C)", LONG_WIDTH, LONG_WIDTH - 1, PRECISION, value_of(solar_panel_.get_max_temperature_C())});
+    if (pump_controller_.is_enabled())
+        columns.push_back({"Pump", SHORT_WIDTH, SHORT_WIDTH, 0, pump_controller_.is_on() ? 1.0 : 0.0});
+    return columns;
+}
+
+void Simulation::print_headers(std::ostream &output_file)
+{
+    for (const LoggedColumn &column : get_logged_columns())
+        output_file << std::setw(column.name_width) << column.name;
+    output_file << "\n";
+}
+
+void Simulation::print_data_line(std::ostream &output_file)
+{
+    for (const LoggedColumn &column : get_logged_columns())
+        output_file << std::setw(column.value_width)
+                    << std::fixed << std::setprecision(column.precision) << column.value;
+    output_file << "\n";
+}
+
+// Count and duration overrides: negative values (and NaN) mean zero instead of wrapping around to
+// billions of layers or seconds
+static unsigned int to_count(Real value)
+{
+    return static_cast<unsigned int>(std::min(std::max(0.0, value_of(value)),
+                                              static_cast<double>(std::numeric_limits<unsigned int>::max())));
+}
+
+// Applies a single named override; returns false for unknown parameters
+bool Simulation::apply_override(const std::string &name, Real value)
+{
+    // Stateless so one table serves every Simulation instance (e.g. concurrent server jobs)
+    static const std::unordered_map<std::string, std::function<void(Simulation &, Real)>> PARAMETER_MAP = {
+        {"SIMULATION_DURATION",	        [](Simulation &simulation, Real value){ simulation.duration_s_ = to_count(value); }},
+        {"SIMULATION_TIME_STEP",	    [](Simulation &simulation, Real value){ simulation.time_step_s_ = to_count(value); }},
+        {"PROGRESS_INTERVAL_S",	        [](Simulation &simulation, Real value){ simulation.progress_interval_s_ = value_of(value); }},
+        {"PROGRESS_PROMETHEUS",	        [](Simulation &simulation, Real value){ simulation.is_progress_prometheus_ = static_cast<bool>(value_of(value)); }},
+        {"IMPLICIT_SOLVER",	            [](Simulation &simulation, Real value){ simulation.is_implicit_solver_ = static_cast<bool>(value_of(value)); }},
+        {"IMPLICIT_TIME_STEP",	        [](Simulation &simulation, Real value){ simulation.implicit_time_step_s_ = to_count(value); }},
+        {"OUTLET_SURROGATE",	        [](Simulation &simulation, Real value){ simulation.is_outlet_surrogate_enabled_ = static_cast<bool>(value_of(value)); }},
+        {"OUTLET_SURROGATE_STEP",	    [](Simulation &simulation, Real value){ simulation.outlet_surrogate_step_C_ = value_of(value); }},
+        {"OUTLET_SURROGATE_TOLERANCE",	[](Simulation &simulation, Real value){ simulation.outlet_surrogate_tolerance_C_ = value_of(value); }},
+        {"PARAREAL_SLICES",	            [](Simulation &simulation, Real value){ simulation.parareal_slices_ = to_count(value); }},
+        {"PARAREAL_COARSE_STEP",	    [](Simulation &simulation, Real value){ simulation.parareal_coarse_step_s_ = to_count(value); }},
+        {"PARAREAL_TOLERANCE",	        [](Simulation &simulation, Real value){ simulation.parareal_tolerance_C_ = value_of(value); }},
+        {"PIPELINE",	                [](Simulation &simulation, Real value){ simulation.is_pipelined_ = static_cast<bool>(value_of(value)); }},
+        {"ENSEMBLE_MEMBERS",	        [](Simulation &simulation, Real value){ simulation.ensemble_members_ = to_count(value); }},
+        {"ENSEMBLE_THREADS",	        [](Simulation &simulation, Real value){ simulation.ensemble_threads_ = to_count(value); }},
+        {"ENSEMBLE_SEED",	            [](Simulation &simulation, Real value){ simulation.ensemble_seed_ = static_cast<uint64_t>(value_of(value)); }},
+        {"ENSEMBLE_CLOUD_NOISE",	    [](Simulation &simulation, Real value){ simulation.ensemble_cloud_noise_ = value_of(value); }},
+        {"ENSEMBLE_WIND_JITTER",	    [](Simulation &simulation, Real value){ simulation.ensemble_wind_jitter_mps_ = value_of(value); }},
+        {"ENSEMBLE_AMBIENT_JITTER",	    [](Simulation &simulation, Real value){ simulation.ensemble_ambient_jitter_C_ = value_of(value); }},
+        {"ENERGY_LEDGER",	            [](Simulation &simulation, Real value){ simulation.is_energy_ledger_enabled_ = static_cast<bool>(value_of(value)); }},
+        {"PUMP_CONTROL",	            [](Simulation &simulation, Real value){ simulation.pump_controller_.set_differential(static_cast<bool>(value_of(value))); }},
+        {"PUMP_ON_DIFFERENTIAL",	    [](Simulation &simulation, Real value){ simulation.pump_controller_.set_on_differential(value_of(value)); }},
+        {"PUMP_OFF_DIFFERENTIAL",	    [](Simulation &simulation, Real value){ simulation.pump_controller_.set_off_differential(value_of(value)); }},
+        {"PUMP_WINDOW_START",	        [](Simulation &simulation, Real value){ simulation.pump_controller_.set_window_start(to_count(value)); }},
+        {"PUMP_WINDOW_END",	            [](Simulation &simulation, Real value){ simulation.pump_controller_.set_window_end(to_count(value)); }},
+        {"PUMP_IDLE_STEP",	            [](Simulation &simulation, Real value){ simulation.pump_idle_step_s_ = std::max(1u, to_count(value)); }},
+        {"RESULT_CACHE",	            [](Simulation &simulation, Real value){ simulation.is_result_cache_enabled_ = static_cast<bool>(value_of(value)); }},
+        {"RESULT_CACHE_MAX_MB",	        [](Simulation &simulation, Real value){ simulation.result_cache_max_MB_ = value_of(value); }},
+        {"STREAM_REALTIME_FACTOR",	    [](Simulation &simulation, Real value){ simulation.stream_realtime_factor_ = value_of(value); }},
+        {"STREAM_LATENCY_BUDGET_MS",	[](Simulation &simulation, Real value){ simulation.stream_latency_budget_ms_ = value_of(value); }},
+
+        {"PANEL_WIDTH",	                [](Simulation &simulation, Real value){ simulation.solar_panel_.set_wdith(value); }},
+        {"PANEL_LENGTH",	            [](Simulation &simulation, Real value){ simulation.solar_panel_.set_length(value); }},
+        {"PANEL_TEMPERATURE",	        [](Simulation &simulation, Real value){ simulation.solar_panel_.set_temperature(value); }},
+        {"PANEL_HEAT_CAPACITY",	        [](Simulation &simulation, Real value){ simulation.solar_panel_.set_specific_heat_capacity(value); }},
+        {"PANEL_IDEAL_EFFICIENCY",	    [](Simulation &simulation, Real value){ simulation.solar_panel_.set_ideal_efficiency(value); }},
+        {"PANEL_EMISSIVITY",	        [](Simulation &simulation, Real value){ simulation.solar_panel_.set_emissivity(value); }},
+        {"PANEL_THICKNESS",	            [](Simulation &simulation, Real value){ simulation.solar_panel_.set_thickness(value); }},
+        {"PANEL_GRID_CELLS",	        [](Simulation &simulation, Real value){ simulation.panel_grid_cells_ = to_count(value); }},
+        {"PANEL_CONDUCTIVITY",	        [](Simulation &simulation, Real value){ simulation.panel_conductivity_WpmK_ = value; }},
+        {"PANEL_EFFICIENCY_COEFFICIENT",[](Simulation &simulation, Real value){ simulation.solar_panel_.set_efficiency_coefficient(value); }},
+
+        {"MASS_FLOW_RATE",              [](Simulation &simulation, Real value){ simulation.tank_.set_mass_flow_rate(value);
+                                                                                  simulation.pipe_into_tank_.set_mass_flow_rate(value); 
+                                                                                  simulation.pipe_into_panel_.set_mass_flow_rate(value); 
+                                                                                  simulation.pipe_on_panel_.set_mass_flow_rate(value); }},
+        {"WATER_MAX_TEMPERATURE",	    [](Simulation &simulation, Real value){ simulation.tank_.set_max_temperature(value);
+                                                                                  simulation.pipe_into_tank_.set_max_temperature(value);
+                                                                                  simulation.pipe_into_panel_.set_max_temperature(value); 
+                                                                                  simulation.pipe_on_panel_.set_max_temperature(value); }},
+        {"WATER_MIN_TEMPERATURE",	    [](Simulation &simulation, Real value){ simulation.tank_.set_min_temperature(value);
+                                                                                  simulation.pipe_into_tank_.set_min_temperature(value);
+                                                                                  simulation.pipe_into_panel_.set_min_temperature(value); 
+                                                                                  simulation.pipe_on_panel_.set_min_temperature(value); }},
+
+        {"TANK_WALL_TEMPERATURE",	    [](Simulation &simulation, Real value){ simulation.tank_.set_temperature(value); }},
+        {"TANK_WATER_TEMPERATURE",	    [](Simulation &simulation, Real value){ simulation.tank_.set_water_temperature(value); }},
+        {"TANK_HEAT_CAPACITY",	        [](Simulation &simulation, Real value){ simulation.tank_.set_specific_heat_capacity(value); }},
+        {"TANK_EMISSIVITY",	            [](Simulation &simulation, Real value){ simulation.tank_.set_emissivity(value); }},
+        {"TANK_THICKNESS",	            [](Simulation &simulation, Real value){ simulation.tank_.set_thickness(value); }},
+        {"TANK_MASS_FLOW_RATE",	        [](Simulation &simulation, Real value){ simulation.tank_.set_mass_flow_rate(value); }},
+        {"TANK_EXPOSED",	            [](Simulation &simulation, Real value){ simulation.tank_.set_exposed(static_cast<bool>(value_of(value))); }},
+        {"TANK_PIPE_LENGTH",	        [](Simulation &simulation, Real value){ simulation.tank_.set_pipe_length(value); }},
+        {"TANK_MAX_TEMPERATURE",	    [](Simulation &simulation, Real value){ simulation.tank_.set_max_temperature(value); }},
+        {"TANK_MIN_TEMPERATURE",	    [](Simulation &simulation, Real value){ simulation.tank_.set_min_temperature(value); }},
+        {"TANK_INTERIOR_DIAMETER",	    [](Simulation &simulation, Real value){ simulation.tank_.set_pipe_interior_diameter(value); }},
+        {"TANK_LAYERS",	                [](Simulation &simulation, Real value){ simulation.tank_layers_ = to_count(value); }},
+
+        {"PIPE2TANK_WALL_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_temperature(value); }},
+        {"PIPE2TANK_WATER_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_water_temperature(value); }},
+        {"PIPE2TANK_HEAT_CAPACITY",	    [](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_specific_heat_capacity(value); }},
+        {"PIPE2TANK_EMISSIVITY",	    [](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_emissivity(value); }},
+        {"PIPE2TANK_THICKNESS",	        [](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_thickness(value); }},
+        {"PIPE2TANK_MASS_FLOW_RATE",	[](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_mass_flow_rate(value); }},
+        {"PIPE2TANK_EXPOSED",	        [](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_exposed(static_cast<bool>(value_of(value))); }},
+        {"PIPE2TANK_PIPE_LENGTH",	    [](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_pipe_length(value); }},
+        {"PIPE2TANK_MAX_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_max_temperature(value); }},
+        {"PIPE2TANK_MIN_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_min_temperature(value); }},
+        {"PIPE2TANK_INTERIOR_DIAMETER",	[](Simulation &simulation, Real value){ simulation.pipe_into_tank_.set_pipe_interior_diameter(value); }},
+
+        {"PIPE2PANEL_WALL_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_temperature(value); }},
+        {"PIPE2PANEL_WATER_TEMPERATURE",[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_water_temperature(value); }},
+        {"PIPE2PANEL_HEAT_CAPACITY",	[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_specific_heat_capacity(value); }},
+        {"PIPE2PANEL_EMISSIVITY",	    [](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_emissivity(value); }},
+        {"PIPE2PANEL_THICKNESS",	    [](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_thickness(value); }},
+        {"PIPE2PANEL_MASS_FLOW_RATE",	[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_mass_flow_rate(value); }},
+        {"PIPE2PANEL_EXPOSED",	        [](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_exposed(static_cast<bool>(value_of(value))); }},
+        {"PIPE2PANEL_PIPE_LENGTH",	    [](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_pipe_length(value); }},
+        {"PIPE2PANEL_MAX_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_max_temperature(value); }},
+        {"PIPE2PANEL_MIN_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_min_temperature(value); }},
+        {"PIPE2PANEL_INTERIOR_DIAMETER",[](Simulation &simulation, Real value){ simulation.pipe_into_panel_.set_pipe_interior_diameter(value); }},
+
+        {"PIPE_PANEL_WALL_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_temperature(value); }},
+        {"PIPE_PANEL_WATER_TEMPERATURE",[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_water_temperature(value); }},
+        {"PIPE_PANEL_HEAT_CAPACITY",	[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_specific_heat_capacity(value); }},
+        {"PIPE_PANEL_EMISSIVITY",	    [](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_emissivity(value); }},
+        {"PIPE_PANEL_THICKNESS",	    [](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_thickness(value); }},
+        {"PIPE_PANEL_MASS_FLOW_RATE",	[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_mass_flow_rate(value); }},
+        {"PIPE_PANEL_EXPOSED",	        [](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_exposed(static_cast<bool>(value_of(value))); }},
+        {"PIPE_PANEL_PIPE_LENGTH",	    [](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_pipe_length(value); }},
+        {"PIPE_PANEL_MAX_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_max_temperature(value); }},
+        {"PIPE_PANEL_MIN_TEMPERATURE",	[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_min_temperature(value); }},
+        {"PIPE_PANEL_INTERIOR_DIAMETER",[](Simulation &simulation, Real value){ simulation.pipe_on_panel_.set_pipe_interior_diameter(value); }}};
+
+    auto parameter_iterator = PARAMETER_MAP.find(name);
+    if (parameter_iterator == PARAMETER_MAP.end())
+        return false;
+
+    parameter_iterator->second(*this, value);
+    return true;
+}
+
+// Values derived from the overrides once they have all been applied
+void Simulation::finalize_constants()
+{
+    Real solar_panel_pipe_length_m = solar_panel_.get_surface_area_m2() *
+                                       solar_panel_.get_pipe_contact_percentage() /
+                                       pipe_on_panel_.get_pipe_interior_diameter_m();
+    pipe_on_panel_.set_pipe_length(solar_panel_pipe_length_m);
+
+    // Layers start at the (possibly overridden) tank water temperature
+    tank_.set_layer_count(tank_layers_);
+}
+
+// Function to read simulation constants from input file
+void Simulation::read_simulation_constants(const std::string &filename)
+{
+    std::ifstream inputFile(filename);
+    if (!inputFile.is_open())
+    {
+        std::cerr << "Error opening input file: " << filename << std::endl;
+        return;
+    }
+
+    std::string paramName;
+    double paramValue;
+    std::unordered_set<std::string> updated_parameters;
+
+    while (inputFile >> paramName >> paramValue)
+    {
+        if (updated_parameters.count(paramName))
+        {
+            std::cerr << "Warning: " << filename << " contains multiple overrides for " 
+                      << paramName << std::endl;
+        }
+        else
+        {
+            updated_parameters.insert(paramName);
+        }
+
+        // Parameters selected for sensitivity analysis carry a unit derivative in their own slot
+        auto sensitivity_iterator = std::find(sensitivity_parameters_.begin(),
+                                              sensitivity_parameters_.end(),
+                                              paramName);
+        if (!apply_override(paramName,
+                            sensitivity_iterator != sensitivity_parameters_.end()
+                                ? seeded_real(paramValue, sensitivity_iterator - sensitivity_parameters_.begin())
+                                : Real(paramValue)))
+        {
+            std::cerr << "Unknown parameter: " << paramName << std::endl;
+        }
+    }
+
+    for (const std::string &parameter_name : sensitivity_parameters_)
+    {
+        if (!updated_parameters.count(parameter_name))
+            std::cerr << "Warning: sensitivity parameter " << parameter_name << " has no override in " << filename
+                      << "; its derivative will be zero" << std::endl;
+    }
+
+    finalize_constants();
+
+    inputFile.close();
+}
+
+// Reads the override names (one per line) whose derivatives are propagated through the run.
+// Only builds with SENSITIVITY_PARAMETERS carry derivatives; other builds ignore the file.
+void Simulation::read_sensitivity_parameters(const std::string &filename)
+{
+#ifdef SENSITIVITY_PARAMETERS
+    std::ifstream input_file(filename);
+    if (!input_file.is_open())
+        return; // Optional file
+
+    std::string parameter_name;
+    while (input_file >> parameter_name)
+    {
+        if (sensitivity_parameters_.size() == SENSITIVITY_PARAMETERS)
+        {
+            std::cerr << "Warning: only " << SENSITIVITY_PARAMETERS << " sensitivity parameters supported by this build, ignoring "
+                      << parameter_name << std::endl;
+            continue;
+        }
+        sensitivity_parameters_.push_back(parameter_name);
+    }
+#else
+    (void)filename;
+#endif
+}
+
+void Simulation::print_sensitivities(std::ofstream &output_file)
+{
+    const Real final_tank_water_temperature_C = tank_.get_water_temperature_C();
+    const Real collected_energy_J = energy_ledger_.get_water_heat_input_J();
+
+    output_file << std::setw(LONG_WIDTH) << "Parameter"
+                << std::setw(LONG_WIDTH + 10) << "d(Tank Water (°C))/dp"
+                << std::setw(LONG_WIDTH + 10) << "d(Collected Energy (J))/dp" << "\n";
+    output_file << std::setw(LONG_WIDTH) << "(value)"
+                << std::setw(LONG_WIDTH + 9) << std::scientific << std::setprecision(6) << value_of(final_tank_water_temperature_C)
+                << std::setw(LONG_WIDTH + 10) << value_of(collected_energy_J) << "\n";
+    for (size_t i = 0; i < sensitivity_parameters_.size(); i++)
+    {
+        output_file << std::setw(LONG_WIDTH) << sensitivity_parameters_[i]
+                    << std::setw(LONG_WIDTH + 9) << derivative_of(final_tank_water_temperature_C, i)
+                    << std::setw(LONG_WIDTH + 10) << derivative_of(collected_energy_J, i) << "\n";
+    }
+}
+
+// Replaces the iterative outlet temperature solve of every pipe (and the tank) by a table lookup,
+// except in table cells that do not reproduce the solve within tolerance
+void Simulation::build_outlet_surrogates()
+{
+    const std::pair<const char *, CylinderContainer *> containers[] = {{"Tank", &tank_},
+                                                                       {"Pipe (To Panel)", &pipe_into_panel_},
+                                                                       {"Pipe (Panel)", &pipe_on_panel_},
+                                                                       {"Pipe (To Tank)", &pipe_into_tank_}};
+    for (const auto &[name, container] : containers)
+    {
+        container->build_outlet_surrogate(outlet_surrogate_step_C_, outlet_surrogate_tolerance_C_);
+        const SurrogateTable &table = container->get_outlet_surrogate();
+        std::cerr << "Outlet surrogate (" << name << "): " << table.size() << " points " << outlet_surrogate_step_C_
+                  << " °C apart, max outlet error " << table.get_max_error(0) << " °C, max heat error "
+                  << table.get_max_error(1) << " W, "
+                  << table.get_invalid_cell_count() << " of " << table.get_cell_count() << " cells solved exactly" << std::endl;
+    }
+}
+
+void Simulation::register_energy_accounts()
+{
+    // Same order as record_energy_flows()
+    energy_ledger_.add_component("Tank");
+    energy_ledger_.add_component("Pipe (To Panel)");
+    energy_ledger_.add_component("Solar Panel");
+    energy_ledger_.add_component("Pipe (Panel)");
+    energy_ledger_.add_component("Pipe (To Tank)");
+}
+
+void Simulation::record_energy_flows()
+{
+    energy_ledger_.record(0, tank_.get_energy_flows());
+    energy_ledger_.record(1, pipe_into_panel_.get_energy_flows());
+    energy_ledger_.record(2, solar_panel_.get_energy_flows());
+    energy_ledger_.record(3, pipe_on_panel_.get_energy_flows());
+    energy_ledger_.record(4, pipe_into_tank_.get_energy_flows());
+}
+
+// Energy held by the solid components (the tank water is accounted through its heat input)
+Real Simulation::get_stored_energy_J() const
+{
+    return tank_.get_stored_energy_J() +
+           pipe_into_panel_.get_stored_energy_J() +
+           solar_panel_.get_stored_energy_J() +
+           pipe_on_panel_.get_stored_energy_J() +
+           pipe_into_tank_.get_stored_energy_J();
+}
+
+// Optimistic estimate of the heat the loop can still bring into the tank before end_time_s: the heat
+// the panel, pipes (walls and water) and tank wall hold above the tank water, all of the sun on the
+// panel at its ideal efficiency and on the exposed cylinders, and convection (plus radiation onto the
+// panel) from air warmer than the tank water. The tank wall counts because the water it warms leaves
+// through the loop and comes back as heat input. Losses are ignored and the tank water is held at
+// its current temperature, which only overstates what a warming tank can take in. The weather is
+// evaluated once per weather sample left instead of once per remaining second. The sun's gains are
+// linear between samples and are integrated exactly (trapezoids). The air's gains are not: the
+// convective coefficient follows the wind while the temperature difference follows the ambient, and
+// their product dips below its chord when the two move in opposite directions. So each interval takes
+// the larger coefficient and the larger ambient temperature of its two ends
+Real Simulation::get_collection_bound_J(unsigned long end_time_s)
+{
+    static constexpr double STEFAN_BOLTZMANN_CONST_WPM2K4 = 5.67e-8; // W / (m^2 * K^4)
+
+    const Real tank_water_temperature_C = tank_.get_water_temperature_C();
+    Real bound_J = solar_panel_.get_heat_capacity_JpK() *
+                   std::max<Real>(0.0, solar_panel_.get_temperature() - tank_water_temperature_C);
+    for (CylinderContainer *pipe : {&pipe_into_panel_, &pipe_on_panel_, &pipe_into_tank_})
+    {
+        Real water_heat_capacity_JpK = pipe->get_water_mass_kg() *
+                                       pipe->get_water_specific_heat_capacity_JpkgC(pipe->get_water_temperature_C());
+        bound_J += pipe->get_heat_capacity_JpK() * std::max<Real>(0.0, pipe->get_temperature() - tank_water_temperature_C) +
+                   water_heat_capacity_JpK * std::max<Real>(0.0, pipe->get_water_temperature_C() - tank_water_temperature_C);
+    }
+    bound_J += tank_.get_heat_capacity_JpK() * std::max<Real>(0.0, tank_.get_temperature() - tank_water_temperature_C);
+
+    if (end_time_s <= current_time_s_)
+        return bound_J;
+
+    const Real panel_area_m2 = solar_panel_.get_surface_area_m2();
+    CylinderContainer *const cylinders[] = {&pipe_into_panel_, &pipe_on_panel_, &pipe_into_tank_, &tank_};
+    struct WeatherSample
+    {
+        Real solar_W;
+        Real ambient_temperature_C;
+        Real plate_coefficient_Wpm2K;
+        std::array<Real, 4> cylinder_coefficients_Wpm2K; // Same order as cylinders, 0 if not exposed
+    };
+    auto get_sample = [&](double time_s)
+    {
+        WeatherSample sample;
+        Real irradiance_Wpm2 = environment_.get_solar_irradiance_Wpm2(time_s);
+        sample.solar_W = irradiance_Wpm2 * panel_area_m2 * solar_panel_.get_ideal_efficiency();
+        sample.ambient_temperature_C = environment_.get_ambient_temperature(time_s);
+        sample.plate_coefficient_Wpm2K = solar_panel_.get_plate_convective_coefficient_Wpm2K(environment_, time_s);
+        for (size_t i = 0; i < 4; i++)
+        {
+            sample.cylinder_coefficients_Wpm2K[i] = 0.0;
+            if (!cylinders[i]->get_exposed())
+                continue;
+            sample.solar_W += irradiance_Wpm2 * cylinders[i]->get_pipe_surface_area_m2(/*is_inner*/ false) *
+                              cylinders[i]->get_emissivity();
+            sample.cylinder_coefficients_Wpm2K[i] = cylinders[i]->get_cylinder_convective_coefficient_Wpm2K(0, environment_, time_s);
+        }
+        return sample;
+    };
+
+    // Upper bound of the air's gain over an interval from the samples at its ends
+    auto get_air_gain_bound_W = [&](const WeatherSample &start, const WeatherSample &end)
+    {
+        Real ambient_temperature_C = std::max(start.ambient_temperature_C, end.ambient_temperature_C);
+        if (ambient_temperature_C <= tank_water_temperature_C)
+            return Real(0.0);
+        Real difference_C = ambient_temperature_C - tank_water_temperature_C;
+        Real gain_W = panel_area_m2 *
+                      (std::max(start.plate_coefficient_Wpm2K, end.plate_coefficient_Wpm2K) * difference_C +
+                       STEFAN_BOLTZMANN_CONST_WPM2K4 * solar_panel_.get_emissivity() *
+                           (pow(ambient_temperature_C + 273.15, 4) - pow(tank_water_temperature_C + 273.15, 4)));
+        for (size_t i = 0; i < 4; i++)
+        {
+            gain_W += std::max(start.cylinder_coefficients_Wpm2K[i], end.cylinder_coefficients_Wpm2K[i]) *
+                      cylinders[i]->get_pipe_surface_area_m2(/*is_inner*/ false) * difference_C;
+        }
+        return gain_W;
+    };
+
+    std::vector<double> times_s = environment_.get_sample_times(current_time_s_, end_time_s);
+    times_s.insert(times_s.begin(), current_time_s_);
+    times_s.push_back(end_time_s);
+    WeatherSample previous = get_sample(times_s.front());
+    for (size_t i = 1; i < times_s.size(); i++)
+    {
+        WeatherSample sample = get_sample(times_s[i]);
+        bound_J += ((previous.solar_W + sample.solar_W) / 2 + get_air_gain_bound_W(previous, sample)) *
+                   (times_s[i] - times_s[i - 1]);
+        previous = sample;
+    }
+    return bound_J;
+}
+
+// Energy the engine created (positive) or destroyed (negative) so far: everything that entered
+// from the environment, less what is now stored in the solids and what reached the tank water
+Real Simulation::get_energy_residual_J() const
+{
+    return energy_ledger_.get_external_net_J() -
+           (get_stored_energy_J() - initial_stored_energy_J_) -
+           energy_ledger_.get_water_heat_input_J();
+}
+
+void Simulation::run_simulation(const std::string &sim_overrides_file,
+                                const std::string &environmental_file,
+                                const std::string &output_filename)
+{
+    std::string input_directory = sim_overrides_file.substr(0, sim_overrides_file.find_last_of("/\\") + 1);
+    read_sensitivity_parameters(input_directory + "sensitivities.txt");
+    read_simulation_constants(sim_overrides_file);
+    environment_.read_environmental_conditions(environmental_file);
+
+    std::ofstream output_file(output_filename);
+    if (!output_file.is_open())
+    {
+        std::cerr << "Error opening output file: " << output_filename << std::endl;
+        return;
+    }
+
+    run(output_file, output_filename);
+    output_file.close();
+}
+
+// Builds what the options ask for before the first step (outlet surrogates, panel grid) and returns
+// whether the run steps implicitly. is_parareal: the run will be cut into parallel-in-time slices
+bool Simulation::prepare_components(bool is_parareal)
+{
+    if (is_outlet_surrogate_enabled_ && !sensitivity_parameters_.empty())
+        std::cerr << "Warning: outlet surrogates carry no parameter derivatives, solving outlets exactly" << std::endl;
+    else if (is_outlet_surrogate_enabled_)
+        build_outlet_surrogates();
+
+    bool is_implicit = is_implicit_solver_ && implicit_time_step_s_ > 0;
+    if (is_implicit && tank_.is_stratified())
+    {
+        std::cerr << "Warning: the implicit solver does not support a stratified tank, using one second updates" << std::endl;
+        is_implicit = false;
+    }
+    else if (is_implicit && pump_controller_.is_enabled())
+    {
+        std::cerr << "Warning: the implicit solver does not support pump control, using one second updates" << std::endl;
+        is_implicit = false;
+    }
+
+    if (panel_grid_cells_ > 0 && (is_implicit || is_parareal || !sensitivity_parameters_.empty() || pump_controller_.is_enabled()))
+    {
+        std::cerr << "Warning: the panel grid needs serial one second updates without sensitivities or pump control, "
+                  << "using the lumped panel" << std::endl;
+    }
+    else if (panel_grid_cells_ > 0)
+    {
+        solar_panel_.build_grid(panel_grid_cells_, panel_conductivity_WpmK_, pipe_on_panel_);
+    }
+
+    return is_implicit;
+}
+
+// Everything that decides the log apart from the duration: the engine version, the weather, the
+// output step, the solver options in use and every field of the components, taken after
+// finalize_constants() so that an override equal to the default, or one that is overwritten later,
+// gives the same key as leaving it out. Options that do not change the log (progress, threads,
+// pipelining, the cache itself) are left out.
+std::string Simulation::get_cache_key() const
+{
+    std::ostringstream key;
+    key << "ENGINE " << ResultCache::ENGINE_VERSION << "\n"
+        << "WEATHER " << std::hex << environment_.get_content_hash() << std::dec << "\n"
+        << std::setprecision(17)
+        << "STEP " << time_step_s_ << "\n";
+    if (is_implicit_solver_)
+        key << "IMPLICIT " << implicit_time_step_s_ << "\n";
+    if (is_outlet_surrogate_enabled_)
+        key << "OUTLET_SURROGATE " << outlet_surrogate_step_C_ << " " << outlet_surrogate_tolerance_C_ << "\n";
+    if (parareal_slices_ > 1)
+        key << "PARAREAL " << parareal_slices_ << " " << parareal_coarse_step_s_ << " " << parareal_tolerance_C_ << "\n";
+    if (panel_grid_cells_ > 0)
+        key << "PANEL_GRID " << panel_grid_cells_ << " " << value_of(panel_conductivity_WpmK_) << "\n";
+    if (pump_controller_.is_enabled())
+    {
+        key << "PUMP ";
+        pump_controller_.print_cache_key(key);
+        key << " " << pump_idle_step_s_ << "\n";
+    }
+
+    const std::pair<const char *, const ThermodynamicObject *> components[] = {{"TANK", &tank_},
+                                                                               {"PIPE2PANEL", &pipe_into_panel_},
+                                                                               {"PANEL", &solar_panel_},
+                                                                               {"PIPE_PANEL", &pipe_on_panel_},
+                                                                               {"PIPE2TANK", &pipe_into_tank_}};
+    for (const auto &[name, component] : components)
+    {
+        key << name << " ";
+        component->print_cache_key(key);
+        key << "\n";
+    }
+    return key.str();
+}
+
+// Runs the configured simulation, logging to output_file. Side outputs (energy ledger, sensitivities)
+// are written next to output_filename; pass an empty name to skip them. With RESULT_CACHE the log
+// comes from the result cache when it holds this run, or continues the longest cached shorter run
+// when the loop state is all there is to resume (no stratified tank, panel grid, implicit solver,
+// pump control or parallel-in-time slices); runs with side outputs other than progress are not cached.
+void Simulation::run(std::ostream &output_file, const std::string &output_filename)
+{
+    if (!is_result_cache_enabled_)
+        return run_uncached(output_file, output_filename);
+    if (is_energy_ledger_enabled_ || !sensitivity_parameters_.empty() || ensemble_members_ > 0)
+    {
+        std::cerr << "Warning: the result cache stores neither the energy ledger, sensitivities nor ensembles, "
+                  << "running uncached" << std::endl;
+        return run_uncached(output_file, output_filename);
+    }
+
+    auto set_cached_state = [this](const std::vector<double> &state)
+    {
+        LoopState loop_state;
+        std::copy(state.begin(), state.end(), loop_state.begin());
+        set_loop_state(loop_state);
+    };
+
+    ResultCache cache(result_cache_directory_, static_cast<uintmax_t>(result_cache_max_MB_ * 1024 * 1024));
+    const std::string key = get_cache_key();
+    ResultCache::Entry entry;
+    if (cache.find(key, duration_s_, entry))
+    {
+        output_file << entry.log;
+        if (entry.state.size() == LOOP_STATE_SIZE)
+            set_cached_state(entry.state);
+        current_time_s_ = duration_s_;
+        cache.record(ResultCache::Outcome::HIT, std::cerr);
+        return;
+    }
+
+    // The implicit solver's last step before the end is clipped and its Jacobian is reused across
+    // steps, neither of which the loop state holds, so implicit runs are only reused whole
+    const bool is_resumable = !tank_.is_stratified() && panel_grid_cells_ == 0 && !is_implicit_solver_ &&
+                              !pump_controller_.is_enabled() && parareal_slices_ <= 1;
+    std::ostringstream log;
+    ResultCache::Outcome outcome = ResultCache::Outcome::MISS;
+    if (is_resumable && cache.find_longest_prefix(key, duration_s_, entry) && entry.state.size() == LOOP_STATE_SIZE)
+    {
+        const bool is_implicit = prepare_components(/*is_parareal*/ false);
+        set_cached_state(entry.state);
+        current_time_s_ = entry.duration_s;
+        log << entry.log;
+        propagate(duration_s_, is_implicit, &log);
+        outcome = ResultCache::Outcome::RESUMED;
+    }
+    else
+    {
+        run_uncached(log, output_filename);
+    }
+    output_file << log.str();
+
+    entry = {duration_s_, log.str(), {}};
+    if (is_resumable)
+    {
+        for (Real value : get_loop_state())
+            entry.state.push_back(value_of(value));
+    }
+    cache.store(key, entry);
+    cache.record(outcome, std::cerr);
+}
+
+void Simulation::run_uncached(std::ostream &output_file, const std::string &output_filename)
+{
+    const bool is_recording_energy = is_energy_ledger_enabled_ || !sensitivity_parameters_.empty();
+    bool is_parareal = parareal_slices_ > 1;
+    if (is_parareal && (is_recording_energy || tank_.is_stratified()))
+    {
+        std::cerr << "Warning: parallel-in-time runs support neither the energy ledger, sensitivities nor a stratified tank, "
+                  << "running serially" << std::endl;
+        is_parareal = false;
+    }
+    else if (is_parareal && pump_controller_.is_enabled())
+    {
+        std::cerr << "Warning: parallel-in-time runs do not support pump control, running serially" << std::endl;
+        is_parareal = false;
+    }
+    if (is_energy_ledger_enabled_ && pump_controller_.is_enabled())
+    {
+        std::cerr << "Warning: the energy ledger does not hold the heat in standing pipe water, "
+                  << "so its residual drifts while the pump is off" << std::endl;
+    }
+
+    const bool is_implicit = prepare_components(is_parareal);
+
+    if (is_recording_energy)
+    {
+        register_energy_accounts();
+        initial_stored_energy_J_ = get_stored_energy_J();
+    }
+
+    std::ofstream ledger_file;
+    if (is_energy_ledger_enabled_ && !output_filename.empty())
+    {
+        std::string ledger_filename = output_filename.substr(0, output_filename.rfind('.')) + "_energy.txt";
+        ledger_file.open(ledger_filename);
+        if (!ledger_file.is_open())
+        {
+            std::cerr << "Error opening output file: " << ledger_filename << std::endl;
+            return;
+        }
+        energy_ledger_.print_headers(ledger_file);
+    }
+    const bool is_writing_ledger = ledger_file.is_open();
+
+    bool is_pipelined = is_pipelined_;
+    if (is_pipelined && (is_implicit || is_parareal || is_recording_energy))
+    {
+        std::cerr << "Warning: pipelined runs need one second updates without the energy ledger, sensitivities, "
+                  << "the implicit solver or parallel-in-time slices, running sequentially" << std::endl;
+        is_pipelined = false;
+    }
+    else if (is_pipelined && pump_controller_.is_enabled())
+    {
+        std::cerr << "Warning: pipelined runs do not support pump control, running sequentially" << std::endl;
+        is_pipelined = false;
+    }
+    else if (is_pipelined && std::thread::hardware_concurrency() < PIPELINE_THREADS)
+    {
+        // The stages spin while they wait for each other, so sharing cores makes them slower than one thread
+        std::cerr << "Warning: pipelined runs need " << PIPELINE_THREADS << " cores, "
+                  << std::thread::hardware_concurrency() << " available, running sequentially" << std::endl;
+        is_pipelined = false;
+    }
+
+    current_time_s_ = 0.0;
+    if (ensemble_members_ > 0 && !output_filename.empty())
+        run_ensemble(output_filename, is_implicit);
+
+    std::string metrics_filename;
+    if (is_progress_prometheus_ && !output_filename.empty())
+        metrics_filename = output_filename.substr(0, output_filename.rfind('.')) + "_progress.prom";
+    progress_reporter_.start(progress_interval_s_, metrics_filename, duration_s_);
+
+    print_headers(output_file);
+    print_data_line(output_file);
+
+    if (is_parareal)
+    {
+        PararealRunner parareal(*this, parareal_slices_, parareal_coarse_step_s_, parareal_tolerance_C_);
+        parareal.run(output_file, is_implicit, progress_reporter_);
+        current_time_s_ = duration_s_;
+    }
+    else if (is_pipelined)
+    {
+        propagate_pipelined(output_file);
+    }
+    else
+    {
+        while (current_time_s_ <= duration_s_ - 1)
+        {
+            unsigned int step_s = advance(is_implicit, duration_s_);
+            if (is_recording_energy)
+                record_energy_flows();
+
+            current_time_s_ += step_s;
+            progress_reporter_.on_tick(current_time_s_, output_file);
+
+            if (std::fmod(current_time_s_, time_step_s_) != 0)
+                continue;
+
+            print_data_line(output_file);
+            if (is_writing_ledger)
+                energy_ledger_.print_interval_line(ledger_file, current_time_s_, get_energy_residual_J());
+        }
+    }
+
+    progress_reporter_.finish(current_time_s_, output_file);
+    if (is_implicit && !is_parareal)
+        loop_solver_.print_statistics(std::cerr);
+    if (pump_controller_.is_enabled())
+        pump_controller_.print_statistics(std::cerr);
+
+    if (is_writing_ledger)
+    {
+        energy_ledger_.print_totals(ledger_file, get_energy_residual_J());
+        ledger_file.close();
+    }
+
+    if (!sensitivity_parameters_.empty() && !output_filename.empty())
+    {
+        std::string sensitivity_filename = output_filename.substr(0, output_filename.rfind('.')) + "_sensitivity.txt";
+        std::ofstream sensitivity_file(sensitivity_filename);
+        if (!sensitivity_file.is_open())
+        {
+            std::cerr << "Error opening output file: " << sensitivity_filename << std::endl;
+            return;
+        }
+        print_sensitivities(sensitivity_file);
+    }
+}
+
+// Follows weather rows as they arrive on weather_input instead of a weather file (see StreamRunner),
+// writing a state row per tick to output_file. Returns false if the options cannot be streamed.
+bool Simulation::run_streaming(std::istream &weather_input, std::ostream &output_file)
+{
+    if (is_energy_ledger_enabled_ || !sensitivity_parameters_.empty() || parareal_slices_ > 1 || is_pipelined_ ||
+        ensemble_members_ > 0 || is_result_cache_enabled_)
+    {
+        std::cerr << "Warning: streaming runs support neither the energy ledger, sensitivities, parallel-in-time slices, "
+                  << "pipelining, ensembles nor the result cache, running without them" << std::endl;
+    }
+    if (stream_realtime_factor_ > 0.0 && time_step_s_ == 0)
+    {
+        // The wall clock ticks once per output step
+        std::cerr << "Error: STREAM_REALTIME_FACTOR above 0 needs a SIMULATION_TIME_STEP above 0" << std::endl;
+        return false;
+    }
+
+    environment_ = Environment();
+    const bool is_implicit = prepare_components(/*is_parareal*/ false);
+    StreamRunner stream(*this, is_implicit, stream_realtime_factor_, stream_latency_budget_ms_);
+    stream.run(weather_input, output_file);
+
+    if (is_implicit)
+        loop_solver_.print_statistics(std::cerr);
+    if (pump_controller_.is_enabled())
+        pump_controller_.print_statistics(std::cerr);
+    stream.print_statistics(std::cerr);
+    return true;
+}
+
+// Runs the weather ensemble from the current (initial) state and writes its quantiles next to the log
+void Simulation::run_ensemble(const std::string &output_filename, bool is_implicit)
+{
+    std::string ensemble_filename = output_filename.substr(0, output_filename.rfind('.')) + "_ensemble.txt";
+    std::ofstream ensemble_file(ensemble_filename);
+    if (!ensemble_file.is_open())
+    {
+        std::cerr << "Error opening output file: " << ensemble_filename << std::endl;
+        return;
+    }
+
+    EnsembleRunner ensemble(*this, ensemble_members_, {ensemble_seed_,
+                                                       ensemble_cloud_noise_,
+                                                       ensemble_wind_jitter_mps_,
+                                                       ensemble_ambient_jitter_C_});
+    ensemble.run(ensemble_file, is_implicit,
+                 ensemble_threads_ > 0 ? ensemble_threads_ : std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Longer steps must stop at the next output line; a time step of 0 logs no lines after the first
+unsigned long Simulation::get_seconds_to_output_line() const
+{
+    if (time_step_s_ == 0)
+        return std::numeric_limits<unsigned long>::max();
+    return time_step_s_ - current_time_s_ % time_step_s_;
+}
+
+// Moves every component forward from current_time_s_ and returns the simulated seconds covered.
+// Implicit steps are shortened so they never cross an output line or end_time_s. With pump control,
+// a second the controller switches the pump off becomes an idle step (advance_idle).
+unsigned int Simulation::advance(bool is_implicit, unsigned long end_time_s)
+{
+    static constexpr unsigned int ONE_SECOND = 1;
+
+    if (is_implicit)
+    {
+        unsigned long step_s = std::min<unsigned long>({implicit_time_step_s_,
+                                                        get_seconds_to_output_line(),
+                                                        end_time_s - current_time_s_});
+        loop_solver_.step(environment_, tank_, pipe_into_panel_, solar_panel_, pipe_on_panel_, pipe_into_tank_,
+                          current_time_s_, step_s);
+        collected_energy_J_ += tank_.get_energy_flows().water_heat_input_J;
+        return step_s;
+    }
+
+    if (pump_controller_.is_enabled())
+    {
+        if (!pump_controller_.update(current_time_s_,
+                                     value_of(solar_panel_.get_temperature()),
+                                     value_of(tank_.get_water_temperature_C())))
+            return advance_idle(end_time_s);
+        pump_controller_.record_running_second();
+    }
+
+    tank_.one_second_update_temperature(pipe_into_tank_.get_water_out_temperature_C(),
+                                        environment_,
+                                        current_time_s_);
+    pipe_into_panel_.one_second_update_temperature(tank_.get_water_out_temperature_C(),
+                                                   environment_,
+                                                   current_time_s_);
+    solar_panel_.one_second_update_temperature(pipe_into_panel_.get_water_out_temperature_C(),
+                                               environment_,
+                                               current_time_s_,
+                                               pipe_on_panel_);
+    pipe_into_tank_.one_second_update_temperature(pipe_on_panel_.get_water_out_temperature_C(),
+                                                  environment_,
+                                                  current_time_s_);
+    collected_energy_J_ += tank_.get_energy_flows().water_heat_input_J;
+    return ONE_SECOND;
+}
+
+// Moves the loop forward with the pump off, in steps of up to pump_idle_step_s_ that never cross an
+// output line, end_time_s or the opening of the pump's time window. Nothing flows, so no heat
+// reaches the tank water through the loop; the controller is sampled again after the step.
+// The step also ends at the first second the thermostat would switch the pump on. The panel and
+// the tank water follow exponentials fixed at the start of the step, so a trial step of any length
+// on copies of them gives their temperatures at that second; the switching second is bisected.
+unsigned int Simulation::advance_idle(unsigned long end_time_s)
+{
+    unsigned long step_s = std::min<unsigned long>({pump_idle_step_s_,
+                                                    get_seconds_to_output_line(),
+                                                    end_time_s - current_time_s_});
+    unsigned long seconds_to_window_open_s = pump_controller_.get_seconds_to_window_open(current_time_s_);
+    if (seconds_to_window_open_s > 0)
+        step_s = std::min(step_s, seconds_to_window_open_s);
+
+    auto would_switch_on_after = [this](unsigned long trial_step_s)
+    {
+        CylinderContainer tank = tank_, panel_pipe = pipe_on_panel_;
+        SolarPanel solar_panel = solar_panel_;
+        tank.idle_update_temperature(environment_, current_time_s_, trial_step_s);
+        solar_panel.idle_update_temperature(environment_, current_time_s_, trial_step_s, panel_pipe);
+        return pump_controller_.would_switch_on(current_time_s_ + trial_step_s,
+                                                value_of(solar_panel.get_temperature()),
+                                                value_of(tank.get_water_temperature_C()));
+    };
+    if (seconds_to_window_open_s == 0 && step_s > 1 && would_switch_on_after(step_s))
+    {
+        unsigned long too_short_s = 0; // The pump stays off after this many seconds
+        while (step_s - too_short_s > 1)
+        {
+            unsigned long middle_s = too_short_s + (step_s - too_short_s) / 2;
+            if (would_switch_on_after(middle_s))
+                step_s = middle_s;
+            else
+                too_short_s = middle_s;
+        }
+    }
+
+    tank_.idle_update_temperature(environment_, current_time_s_, step_s);
+    pipe_into_panel_.idle_update_temperature(environment_, current_time_s_, step_s);
+    solar_panel_.idle_update_temperature(environment_, current_time_s_, step_s, pipe_on_panel_);
+    pipe_into_tank_.idle_update_temperature(environment_, current_time_s_, step_s);
+    pump_controller_.record_idle_step(step_s);
+    return step_s;
+}
+
+// Runs the one second updates from current_time_s_ to the end with each component group on its
+// own thread, passing water out temperatures downstream through single-producer/single-consumer
+// queues. Every component does its own half of a second (sun, air, panel to pipe conduction) as
+// soon as it has finished the previous second, while the water is still on its way round the loop,
+// so the components work on consecutive seconds at once. Each component still sees exactly the
+// same inputs in the same order as in advance(), so the log is bit-identical.
+// The loop is closed (the tank takes in the water the pipe into the tank let out the second before),
+// so the water halves still run one after another; the speedup is bounded by how much of a second
+// is spent on the surroundings (most of it with PANEL_GRID_CELLS).
+void Simulation::propagate_pipelined(std::ostream &output_file)
+{
+    static constexpr unsigned int WORKER_STAGES = PIPELINE_THREADS - 1; // Tank, pipe into panel, panel; this thread runs the pipe into the tank
+
+    SpscQueue<Real> into_tank, into_pipe_into_panel, into_panel, into_pipe_into_tank;
+    into_tank.push(pipe_into_tank_.get_water_out_temperature_C());
+
+    const unsigned long start_time_s = current_time_s_;
+    const unsigned long end_time_s = duration_s_;
+
+    // Output lines need every component at the same second: after the second before a line each
+    // worker checks in and waits until this thread has printed it
+    std::atomic<unsigned int> waiting_stages(0);
+    std::atomic<unsigned long> printed_lines(0);
+    auto is_output_line = [this](unsigned long time_s){ return time_step_s_ != 0 && time_s % time_step_s_ == 0; };
+
+    auto run_stage = [&](auto update_surroundings, auto update_water, SpscQueue<Real> &intake, SpscQueue<Real> &outlet)
+    {
+        unsigned long lines = 0;
+        for (unsigned long time_s = start_time_s; time_s < end_time_s; time_s++)
+        {
+            update_surroundings(time_s);
+            outlet.push(update_water(intake.pop()));
+
+            if (!is_output_line(time_s + 1))
+                continue;
+            lines++;
+            waiting_stages++;
+            while (printed_lines.load() < lines)
+                std::this_thread::yield();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.emplace_back(run_stage,
+                         [this](unsigned long time_s){ tank_.one_second_update_surroundings(environment_, time_s); },
+                         [this](Real intake_C){ tank_.one_second_update_water(intake_C);
+                                                collected_energy_J_ += tank_.get_energy_flows().water_heat_input_J;
+                                                return tank_.get_water_out_temperature_C(); },
+                         std::ref(into_tank), std::ref(into_pipe_into_panel));
+    workers.emplace_back(run_stage,
+                         [this](unsigned long time_s){ pipe_into_panel_.one_second_update_surroundings(environment_, time_s); },
+                         [this](Real intake_C){ pipe_into_panel_.one_second_update_water(intake_C);
+                                                return pipe_into_panel_.get_water_out_temperature_C(); },
+                         std::ref(into_pipe_into_panel), std::ref(into_panel));
+    workers.emplace_back(run_stage,
+                         [this](unsigned long time_s){ solar_panel_.one_second_update_surroundings(environment_, time_s, pipe_on_panel_); },
+                         [this](Real intake_C){ pipe_on_panel_.one_second_update_water(intake_C);
+                                                return pipe_on_panel_.get_water_out_temperature_C(); },
+                         std::ref(into_panel), std::ref(into_pipe_into_tank));
+
+    for (unsigned long time_s = start_time_s; time_s < end_time_s; time_s++)
+    {
+        pipe_into_tank_.one_second_update_surroundings(environment_, time_s);
+        pipe_into_tank_.one_second_update_water(into_pipe_into_tank.pop());
+        into_tank.push(pipe_into_tank_.get_water_out_temperature_C());
+
+        current_time_s_ = time_s + 1;
+        progress_reporter_.on_tick(current_time_s_, output_file);
+
+        if (!is_output_line(current_time_s_))
+            continue;
+        while (waiting_stages.load() < WORKER_STAGES)
+            std::this_thread::yield();
+        waiting_stages = 0;
+        print_data_line(output_file);
+        printed_lines++;
+    }
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+// Turns this copy into the coarse parallel-in-time propagator: implicit steps of coarse_step_s
+void Simulation::use_coarse_solver(unsigned int coarse_step_s)
+{
+    is_implicit_solver_ = true;
+    implicit_time_step_s_ = coarse_step_s;
+    time_step_s_ = coarse_step_s; // Never prints, so only bounds the step
+}
+
+Simulation::LoopState Simulation::get_loop_state() const
+{
+    return {tank_.get_temperature(),
+            pipe_into_panel_.get_temperature(),
+            solar_panel_.get_temperature(),
+            pipe_on_panel_.get_temperature(),
+            pipe_into_tank_.get_temperature(),
+            tank_.get_water_temperature_C(),
+            pipe_into_panel_.get_water_temperature_C(),
+            pipe_on_panel_.get_water_temperature_C(),
+            pipe_into_tank_.get_water_temperature_C(),
+            tank_.get_water_out_temperature_C(),
+            pipe_into_panel_.get_water_out_temperature_C(),
+            pipe_on_panel_.get_water_out_temperature_C(),
+            pipe_into_tank_.get_water_out_temperature_C()};
+}
+
+void Simulation::set_loop_state(const LoopState &state)
+{
+    tank_.set_temperature(state[0]);
+    pipe_into_panel_.set_temperature(state[1]);
+    solar_panel_.set_temperature(state[2]);
+    pipe_on_panel_.set_temperature(state[3]);
+    pipe_into_tank_.set_temperature(state[4]);
+    tank_.set_water_temperature(state[5]);
+    pipe_into_panel_.set_water_temperature(state[6]);
+    pipe_on_panel_.set_water_temperature(state[7]);
+    pipe_into_tank_.set_water_temperature(state[8]);
+    tank_.set_water_out_temperature(state[9]);
+    pipe_into_panel_.set_water_out_temperature(state[10]);
+    pipe_on_panel_.set_water_out_temperature(state[11]);
+    pipe_into_tank_.set_water_out_temperature(state[12]);
+}
+
+// Advances from current_time_s_ to end_time_s, logging every output line reached when output_file is given
+void Simulation::propagate(unsigned long end_time_s, bool is_implicit, std::ostream *output_file)
+{
+    while (current_time_s_ < end_time_s)
+    {
+        current_time_s_ += advance(is_implicit, end_time_s);
+        if (output_file && std::fmod(current_time_s_, time_step_s_) == 0)
+            print_data_line(*output_file);
+    }
+}
@@ -1,86 +1,189 @@
-#include "include/SolarPanel.hpp"
-
-double SolarPanel::get_plate_convective_coefficient_Wpm2K(const Environment &environment, double current_time_s)
-{
-    double characteristic_length_m = length_m_;
-    double film_temperature_C = (environment.get_ambient_temperature(current_time_s) + temperature_C_) / 2; // T_f, mean temperature
-    double dynamic_viscosity_kgpms = environment.get_air_dynamic_viscosity_kgpms(film_temperature_C);       // μ
-    double thermal_conductivity_WpmK = environment.get_air_thermal_conductivity_WpmK(film_temperature_C);   // k
-    double air_density_kgpm3 = environment.get_air_density_kgpm3(film_temperature_C);                       // ρ
-    double flow_velocity_mps = environment.get_wind_speed(current_time_s);
-    double specific_heat_capacity_JpkgC = environment.get_air_specific_heat_capacity_JpkgC(film_temperature_C); // C_p
-
-    double reynolds_number = (air_density_kgpm3 * flow_velocity_mps * characteristic_length_m) /
-                             dynamic_viscosity_kgpms;
-    double prandtl_number = specific_heat_capacity_JpkgC * dynamic_viscosity_kgpms / thermal_conductivity_WpmK;
-
-    double transition_to_turbulent_flow_m = (TURBULENT_FLOW_LOWER_BOUND_FLAT_PLATE * dynamic_viscosity_kgpms) /
-                                            (air_density_kgpm3 * flow_velocity_mps);
-    double threshold_to_include_laminar_flow_m = LAMINAR_PLATE_MINIMUM_THRESHOLD * characteristic_length_m;
-
-    double nusselt_number;
-    if (transition_to_turbulent_flow_m <= threshold_to_include_laminar_flow_m)
-    { // Only turbulent flow
-        nusselt_number = 0.037 * std::pow(reynolds_number, 0.8) * std::pow(prandtl_number, 0.333);
-    }
-    else if (characteristic_length_m <= transition_to_turbulent_flow_m)
-    { // Only laminar flow
-        nusselt_number = 0.664 *
-                         std::pow((air_density_kgpm3 * flow_velocity_mps) /
-                                      (dynamic_viscosity_kgpms * characteristic_length_m),
-                                  0.5) *
-                         std::pow(prandtl_number, 0.333);
-    }
-    else
-    { // Mixed flow
-        nusselt_number = (0.037 * std::pow(reynolds_number, 0.8) - 871) * std::pow(prandtl_number, 0.333);
-    }
-
-    // Calculate convection coefficient (h)
-    return (nusselt_number * thermal_conductivity_WpmK) / characteristic_length_m;
-}
-
-void SolarPanel::one_second_update_temperature(double intake_water_temperature_C,
-                                               const Environment &environment,
-                                               double current_time_s,
-                                               CylinderContainer &panel_pipe)
-{
-    const double COPPER_THERMAL_CONDUCTIVITY_WPMK = 413.0;
-    const double STEFAN_BOLTZMANN_CONST_WPM2K4 = 5.67e-8; // W / (m^2 * K^4)
-    const double MIN_PANEL_EFFICIENCY = 0.05;
-
-    double efficiency_drop_from_heat = 1.0 - efficiency_coefficient_ * ((temperature_C_ - MAX_IDEAL_TEMPURATURE_C) / 100);
-    double panel_efficiency = temperature_C_ <= MAX_IDEAL_TEMPURATURE_C ? ideal_efficiency_
-                                                                        : ideal_efficiency_ * std::clamp(efficiency_drop_from_heat, MIN_PANEL_EFFICIENCY, 1.0);
-
-    double heat_from_sun_W = environment.get_solar_irradiance_Wpm2(current_time_s) *
-                             panel_efficiency *
-                             get_surface_area_m2();
-
-    double ambient_temperature_C = environment.get_ambient_temperature(current_time_s);
-    double panel_radiative_loss_W = STEFAN_BOLTZMANN_CONST_WPM2K4 *
-                                    emissivity_ * get_surface_area_m2() *
-                                    (std::pow(temperature_C_ + 273.15, 4) -
-                                     std::pow(ambient_temperature_C + 273.15, 4));
-
-    double contact_area_m2 = get_surface_area_m2() * PIPE_PANEL_CONTACT_PERCENTAGE;
-    double pipe_length_in_contact_panel_m = contact_area_m2 / panel_pipe.get_pipe_interior_diameter_m();
-    double panel_conductive_loss_to_pipe_W = COPPER_THERMAL_CONDUCTIVITY_WPMK *
-                                             contact_area_m2 *
-                                             (temperature_C_ - panel_pipe.get_temperature()) /
-                                             pipe_length_in_contact_panel_m;
-
-    double panel_convective_loss_air_W = get_plate_convective_coefficient_Wpm2K(environment, current_time_s) *
-                                         get_surface_area_m2() *
-                                         (temperature_C_ - ambient_temperature_C);
-
-    double total_energy_added_W = heat_from_sun_W -
-                                  panel_radiative_loss_W -
-                                  panel_conductive_loss_to_pipe_W -
-                                  panel_convective_loss_air_W;
-
-    add_tempurature(total_energy_added_W);
-    panel_pipe.add_tempurature(panel_conductive_loss_to_pipe_W);
-
-    panel_pipe.one_second_update_temperature(intake_water_temperature_C, environment, current_time_s);
-}
+#include "include/SolarPanel.hpp"
+
+Real SolarPanel::get_plate_convective_coefficient_Wpm2K(const Environment &environment, double current_time_s)
+{
+    Real characteristic_length_m = length_m_;
+    Real film_temperature_C = (environment.get_ambient_temperature(current_time_s) + temperature_C_) / 2; // T_f, mean temperature
+    Real dynamic_viscosity_kgpms = environment.get_air_dynamic_viscosity_kgpms(film_temperature_C);       // μ
+    Real thermal_conductivity_WpmK = environment.get_air_thermal_conductivity_WpmK(film_temperature_C);   // k
+    Real air_density_kgpm3 = environment.get_air_density_kgpm3(film_temperature_C);                       // ρ
+    Real flow_velocity_mps = environment.get_wind_speed(current_time_s);
+    Real specific_heat_capacity_JpkgC = environment.get_air_specific_heat_capacity_JpkgC(film_temperature_C); // C_p
+
+    Real reynolds_number = (air_density_kgpm3 * flow_velocity_mps * characteristic_length_m) /
+                             dynamic_viscosity_kgpms;
+    Real prandtl_number = specific_heat_capacity_JpkgC * dynamic_viscosity_kgpms / thermal_conductivity_WpmK;
+
+    Real transition_to_turbulent_flow_m = (TURBULENT_FLOW_LOWER_BOUND_FLAT_PLATE * dynamic_viscosity_kgpms) /
+                                            (air_density_kgpm3 * flow_velocity_mps);
+    Real threshold_to_include_laminar_flow_m = LAMINAR_PLATE_MINIMUM_THRESHOLD * characteristic_length_m;
+
+    Real nusselt_number;
+    if (transition_to_turbulent_flow_m <= threshold_to_include_laminar_flow_m)
+    { // Only turbulent flow
+        nusselt_number = 0.037 * pow(reynolds_number, 0.8) * pow(prandtl_number, 0.333);
+    }
+    else if (characteristic_length_m <= transition_to_turbulent_flow_m)
+    { // Only laminar flow
+        nusselt_number = 0.664 *
+                         pow((air_density_kgpm3 * flow_velocity_mps) /
+                                      (dynamic_viscosity_kgpms * characteristic_length_m),
+                                  0.5) *
+                         pow(prandtl_number, 0.333);
+    }
+    else
+    { // Mixed flow
+        nusselt_number = (0.037 * pow(reynolds_number, 0.8) - 871) * pow(prandtl_number, 0.333);
+    }
+
+    // Calculate convection coefficient (h)
+    return (nusselt_number * thermal_conductivity_WpmK) / characteristic_length_m;
+}
+
+SolarPanel::HeatFlows SolarPanel::get_heat_flows_W(const Environment &environment,
+                                                  double current_time_s,
+                                                  const CylinderContainer &panel_pipe)
+{
+    HeatFlows flows;
+    Real efficiency_drop_from_heat = 1.0 - efficiency_coefficient_ * ((temperature_C_ - MAX_IDEAL_TEMPURATURE_C) / 100);
+    Real panel_efficiency = temperature_C_ <= MAX_IDEAL_TEMPURATURE_C ? ideal_efficiency_
+                                                                      : ideal_efficiency_ * std::clamp<Real>(efficiency_drop_from_heat, MIN_PANEL_EFFICIENCY, 1.0);
+
+    flows.solar_W = environment.get_solar_irradiance_Wpm2(current_time_s) *
+                    panel_efficiency *
+                    get_surface_area_m2();
+
+    Real ambient_temperature_C = environment.get_ambient_temperature(current_time_s);
+    flows.radiative_loss_W = STEFAN_BOLTZMANN_CONST_WPM2K4 *
+                             emissivity_ * get_surface_area_m2() *
+                             (pow(temperature_C_ + 273.15, 4) -
+                              pow(ambient_temperature_C + 273.15, 4));
+
+    Real contact_area_m2 = get_surface_area_m2() * PIPE_PANEL_CONTACT_PERCENTAGE;
+    Real pipe_length_in_contact_panel_m = contact_area_m2 / panel_pipe.get_pipe_interior_diameter_m();
+    flows.conductive_loss_to_pipe_W = COPPER_THERMAL_CONDUCTIVITY_WPMK *
+                                      contact_area_m2 *
+                                      (temperature_C_ - panel_pipe.get_temperature()) /
+                                      pipe_length_in_contact_panel_m;
+
+    flows.convective_loss_air_W = get_plate_convective_coefficient_Wpm2K(environment, current_time_s) *
+                                  get_surface_area_m2() *
+                                  (temperature_C_ - ambient_temperature_C);
+    return flows;
+}
+
+void SolarPanel::print_cache_key(std::ostream &key) const
+{
+    ThermodynamicObject::print_cache_key(key);
+    key << " " << value_of(width_m_) << " " << value_of(length_m_) << " " << value_of(ideal_efficiency_)
+        << " " << value_of(efficiency_coefficient_);
+}
+
+// Replaces the lumped temperature with a cells x cells field starting at the current temperature.
+// The lumped model's conductance into the pipe (contact area over contact length) is kept.
+void SolarPanel::build_grid(size_t cells, Real thermal_conductivity_WpmK, const CylinderContainer &panel_pipe)
+{
+    Real contact_area_m2 = get_surface_area_m2() * PIPE_PANEL_CONTACT_PERCENTAGE;
+    Real pipe_length_in_contact_panel_m = contact_area_m2 / panel_pipe.get_pipe_interior_diameter_m();
+    Real pipe_conductance_WpK = COPPER_THERMAL_CONDUCTIVITY_WPMK * contact_area_m2 / pipe_length_in_contact_panel_m;
+
+    grid_.build(cells,
+                value_of(length_m_),
+                value_of(width_m_),
+                value_of(thickness_m_),
+                value_of(AVERAGE_PANEL_DENSITY_KGPM3 * specific_heat_capacity_JpkgC_),
+                value_of(thermal_conductivity_WpmK),
+                value_of(pipe_length_in_contact_panel_m),
+                value_of(pipe_conductance_WpK),
+                value_of(temperature_C_));
+}
+
+void SolarPanel::one_second_update_temperature(Real intake_water_temperature_C,
+                                               const Environment &environment,
+                                               double current_time_s,
+                                               CylinderContainer &panel_pipe)
+{
+    one_second_update_surroundings(environment, current_time_s, panel_pipe);
+    panel_pipe.one_second_update_water(intake_water_temperature_C);
+}
+
+// Everything up to the water entering the pipe on the panel, which is all the panel itself does
+void SolarPanel::one_second_update_surroundings(const Environment &environment,
+                                                double current_time_s,
+                                                CylinderContainer &panel_pipe)
+{
+    HeatFlows flows;
+    if (grid_.empty())
+    {
+        flows = get_heat_flows_W(environment, current_time_s, panel_pipe);
+
+        Real total_energy_added_W = flows.solar_W -
+                                    flows.radiative_loss_W -
+                                    flows.conductive_loss_to_pipe_W -
+                                    flows.convective_loss_air_W;
+
+        add_tempurature(total_energy_added_W);
+    }
+    else
+    {
+        // Convection is driven by the mean plate temperature (temperature_C_ tracks the field mean)
+        PanelGrid::Conditions conditions;
+        conditions.irradiance_Wpm2 = environment.get_solar_irradiance_Wpm2(current_time_s);
+        conditions.ambient_temperature_C = environment.get_ambient_temperature(current_time_s);
+        conditions.convective_coefficient_Wpm2K = value_of(get_plate_convective_coefficient_Wpm2K(environment, current_time_s));
+        conditions.pipe_temperature_C = value_of(panel_pipe.get_temperature());
+        conditions.ideal_efficiency = value_of(ideal_efficiency_);
+        conditions.efficiency_coefficient = value_of(efficiency_coefficient_);
+        conditions.max_ideal_temperature_C = MAX_IDEAL_TEMPURATURE_C;
+        conditions.min_efficiency = MIN_PANEL_EFFICIENCY;
+        conditions.emissivity = value_of(emissivity_);
+
+        PanelGrid::Flows grid_flows = grid_.update(/*time_step_s*/ 1.0, conditions);
+        flows.solar_W = grid_flows.solar_W;
+        flows.radiative_loss_W = grid_flows.radiative_loss_W;
+        flows.conductive_loss_to_pipe_W = grid_flows.conductive_loss_to_pipe_W;
+        flows.convective_loss_air_W = grid_flows.convective_loss_air_W;
+        temperature_C_ = grid_.get_mean_temperature_C();
+    }
+    panel_pipe.add_tempurature(flows.conductive_loss_to_pipe_W);
+
+    energy_flows_.solar_absorbed_J = flows.solar_W;
+    energy_flows_.convective_loss_J = flows.convective_loss_air_W;
+    energy_flows_.radiative_loss_J = flows.radiative_loss_W;
+    energy_flows_.conducted_out_J = flows.conductive_loss_to_pipe_W;
+
+    panel_pipe.one_second_update_surroundings(environment, current_time_s);
+}
+
+// Advances step_s seconds with the pump off (lumped panel only): the exact solution of the panel's
+// heat balance linearized at the start of the step, with the sun, air and pipe temperatures held
+// fixed, then the stagnant pipe on the panel (see CylinderContainer::idle_update_temperature)
+void SolarPanel::idle_update_temperature(const Environment &environment,
+                                         double current_time_s,
+                                         double step_s,
+                                         CylinderContainer &panel_pipe)
+{
+    HeatFlows flows = get_heat_flows_W(environment, current_time_s, panel_pipe);
+
+    Real contact_area_m2 = get_surface_area_m2() * PIPE_PANEL_CONTACT_PERCENTAGE;
+    Real pipe_length_in_contact_panel_m = contact_area_m2 / panel_pipe.get_pipe_interior_diameter_m();
+    Real pipe_conductance_WpK = COPPER_THERMAL_CONDUCTIVITY_WPMK * contact_area_m2 / pipe_length_in_contact_panel_m;
+    Real total_conductance_WpK = get_plate_convective_coefficient_Wpm2K(environment, current_time_s) * get_surface_area_m2() +
+                                 4 * STEFAN_BOLTZMANN_CONST_WPM2K4 * emissivity_ * get_surface_area_m2() *
+                                     pow(temperature_C_ + 273.15, 3) +
+                                 pipe_conductance_WpK;
+
+    Real net_heat_W = flows.solar_W - flows.radiative_loss_W - flows.conductive_loss_to_pipe_W - flows.convective_loss_air_W;
+    Real temperature_change_C = net_heat_W / total_conductance_WpK *
+                                (1.0 - exp(-total_conductance_WpK * step_s / get_heat_capacity_JpK()));
+    temperature_C_ += temperature_change_C;
+
+    // Sun, radiation and conduction at the start of the step, the air as whatever balances the panel
+    energy_flows_.solar_absorbed_J = flows.solar_W * step_s;
+    energy_flows_.radiative_loss_J = flows.radiative_loss_W * step_s;
+    energy_flows_.conducted_out_J = flows.conductive_loss_to_pipe_W * step_s;
+    energy_flows_.convective_loss_J = energy_flows_.solar_absorbed_J - energy_flows_.radiative_loss_J -
+                                      energy_flows_.conducted_out_J - get_heat_capacity_JpK() * temperature_change_C;
+
+    panel_pipe.idle_update_temperature(environment, current_time_s, step_s, pipe_conductance_WpK, temperature_C_);
+}
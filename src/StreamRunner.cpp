@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "include/StreamRunner.hpp"
+
+StreamRunner::StreamRunner(Simulation &simulation,
+                           bool is_implicit,
+                           double realtime_factor,
+                           double latency_budget_ms) : simulation_(simulation),
+                                                       is_implicit_(is_implicit),
+                                                       realtime_factor_(realtime_factor),
+                                                       latency_budget_ms_(latency_budget_ms) {}
+
+// Reader thread: queues every well formed row the moment its line is complete
+void StreamRunner::read(std::istream &input)
+{
+    std::string line;
+    while (std::getline(input, line))
+    {
+        Sample sample;
+        sample.arrival = Clock::now();
+        std::istringstream line_stream(line);
+        if (!(line_stream >> sample.time_s >> sample.solar_irradiance_Wpm2 >> sample.ambient_temperature_C >> sample.wind_speed_mps))
+        {
+            if (line.find_first_not_of(" \t\r") != std::string::npos)
+                std::cerr << "Warning: skipping weather row that is not \"time irradiance ambient wind\": " << line << std::endl;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(samples_mutex_);
+            samples_.push_back(sample);
+        }
+        samples_available_.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(samples_mutex_);
+        is_input_closed_ = true;
+    }
+    samples_available_.notify_one();
+}
+
+// Appends every row that has arrived to the weather; returns how many were taken. The first
+// accepted row starts the pending row's latency if none is pending.
+size_t StreamRunner::take_samples()
+{
+    std::deque<Sample> samples;
+    {
+        std::lock_guard<std::mutex> lock(samples_mutex_);
+        samples.swap(samples_);
+    }
+
+    for (const Sample &sample : samples)
+    {
+        if (!simulation_.add_environment_sample(sample.time_s, sample.solar_irradiance_Wpm2,
+                                                sample.ambient_temperature_C, sample.wind_speed_mps))
+        {
+            std::cerr << "Warning: ignoring weather row at " << sample.time_s << " s, not after the row before" << std::endl;
+            samples_rejected_++;
+        }
+        else if (!is_row_pending_)
+        {
+            is_row_pending_ = true;
+            pending_since_ = sample.arrival;
+        }
+    }
+    samples_received_ += samples.size();
+    return samples.size();
+}
+
+void StreamRunner::emit(std::ostream &output_file, Clock::time_point since)
+{
+    simulation_.print_data_line(output_file);
+    output_file.flush();
+
+    double latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+    latency_p50_ms_.add(latency_ms);
+    latency_p95_ms_.add(latency_ms);
+    latency_p99_ms_.add(latency_ms);
+    max_latency_ms_ = std::max(max_latency_ms_, latency_ms);
+    if (latency_ms > latency_budget_ms_)
+        rows_over_budget_++;
+    rows_++;
+}
+
+void StreamRunner::run_input_driven(std::ostream &output_file)
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(samples_mutex_);
+            samples_available_.wait(lock, [this] { return !samples_.empty() || is_input_closed_; });
+        }
+        if (take_samples() == 0)
+            return;
+        follow_input(output_file);
+    }
+}
+
+// Input driven tick: moves to the latest row's (whole) second, if that is later. Otherwise the rows
+// stay pending and the next tick's latency still counts from the oldest of them.
+void StreamRunner::follow_input(std::ostream &output_file)
+{
+    unsigned long end_time_s = static_cast<unsigned long>(std::max(0.0, std::floor(simulation_.get_environment().get_end_time())));
+    if (end_time_s <= simulation_.get_current_time_s())
+        return;
+    simulation_.propagate(end_time_s, is_implicit_, nullptr);
+    emit(output_file, pending_since_);
+    is_row_pending_ = false;
+}
+
+void StreamRunner::run_wall_clock(std::ostream &output_file, Clock::time_point start, unsigned long start_time_s)
+{
+    const unsigned long step_s = simulation_.get_time_step_s();
+    auto get_due_time = [&](unsigned long time_s)
+    {
+        return start + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>((time_s - start_time_s) / realtime_factor_));
+    };
+
+    while (true)
+    {
+        unsigned long time_s = (simulation_.get_current_time_s() / step_s + 1) * step_s;
+        {
+            std::unique_lock<std::mutex> lock(samples_mutex_);
+            if (samples_available_.wait_until(lock, get_due_time(time_s), [this] { return is_input_closed_; }))
+                return;
+        }
+
+        // Behind: go straight to the step that is due
+        double elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+        unsigned long due_time_s = (start_time_s + static_cast<unsigned long>(elapsed_s * realtime_factor_)) / step_s * step_s;
+        if (due_time_s > time_s)
+        {
+            ticks_skipped_ += (due_time_s - time_s) / step_s;
+            time_s = due_time_s;
+        }
+
+        take_samples();
+        simulation_.propagate(time_s, is_implicit_, nullptr);
+        emit(output_file, get_due_time(time_s));
+    }
+}
+
+void StreamRunner::run(std::istream &input, std::ostream &output_file)
+{
+    std::thread reader(&StreamRunner::read, this, std::ref(input));
+
+    {
+        std::unique_lock<std::mutex> lock(samples_mutex_);
+        samples_available_.wait(lock, [this] { return !samples_.empty() || is_input_closed_; });
+    }
+    if (take_samples() > 0)
+    {
+        const Clock::time_point first_arrival = pending_since_;
+        // Simulated time starts at the first row's time, so time stamps (e.g. seconds of the day for
+        // the pump window) keep their meaning
+        const unsigned long start_time_s = static_cast<unsigned long>(std::max(0.0, std::floor(simulation_.get_environment().get_start_time())));
+        simulation_.set_current_time_s(start_time_s);
+        simulation_.print_headers(output_file);
+        emit(output_file, first_arrival);
+        // Rows that arrived with the first one wait for the next tick, counted from the first's arrival
+        is_row_pending_ = simulation_.get_environment().get_end_time() > simulation_.get_environment().get_start_time();
+
+        if (realtime_factor_ > 0.0)
+        {
+            run_wall_clock(output_file, first_arrival, start_time_s);
+        }
+        else
+        {
+            follow_input(output_file); // Rows that arrived with the first one
+            run_input_driven(output_file);
+        }
+    }
+
+    reader.join();
+}
+
+void StreamRunner::print_statistics(std::ostream &output) const
+{
+    output << "Stream: " << rows_ << " rows from " << samples_received_ << " weather rows";
+    if (realtime_factor_ > 0.0)
+        output << ", " << ticks_skipped_ << " steps skipped to catch up";
+    else
+        output << ", " << samples_received_ - samples_rejected_ - std::min(rows_, samples_received_ - samples_rejected_)
+               << " taken together with a later row";
+    if (samples_rejected_ > 0)
+        output << ", " << samples_rejected_ << " out of order rows ignored";
+    output << "\n";
+
+    output << "Stream latency: " << std::fixed << std::setprecision(3)
+           << "p50 " << latency_p50_ms_.get() << " ms, "
+           << "p95 " << latency_p95_ms_.get() << " ms, "
+           << "p99 " << latency_p99_ms_.get() << " ms, "
+           << "max " << max_latency_ms_ << " ms, "
+           << rows_over_budget_ << " rows over the " << std::setprecision(0) << latency_budget_ms_ << " ms budget" << std::endl;
+}
@@ -0,0 +1,51 @@
+#include <cmath>
+
+#include "include/SurrogateTable.hpp"
+
+void SurrogateTable::build(double x_min, double x_max, double y_min, double y_max, double step,
+                           double first_tolerance, double second_tolerance, const Evaluate &evaluate)
+{
+    x_min_ = x_min;
+    y_min_ = y_min;
+    step_ = step;
+    x_count_ = std::max<size_t>(2, static_cast<size_t>(std::ceil((x_max - x_min) / step)) + 1);
+    y_count_ = std::max<size_t>(2, static_cast<size_t>(std::ceil((y_max - y_min) / step)) + 1);
+
+    values_.assign(x_count_ * y_count_, {});
+    for (size_t i = 0; i < x_count_; i++)
+    {
+        for (size_t j = 0; j < y_count_; j++)
+        {
+            std::array<double, 2> &value = values_[i * y_count_ + j];
+            evaluate(x_min_ + i * step_, y_min_ + j * step_, value[0], value[1]);
+        }
+    }
+
+    // Check every cell at its centre, where bilinear interpolation is furthest from the nodes
+    is_cell_valid_.assign((x_count_ - 1) * (y_count_ - 1), true);
+    max_error_ = {0.0, 0.0};
+    invalid_cells_ = 0;
+    for (size_t i = 0; i + 1 < x_count_; i++)
+    {
+        for (size_t j = 0; j + 1 < y_count_; j++)
+        {
+            double exact_first, exact_second;
+            Real table_first, table_second;
+            evaluate(x_min_ + (i + 0.5) * step_, y_min_ + (j + 0.5) * step_, exact_first, exact_second);
+            interpolate(i, j, 0.5, 0.5, table_first, table_second);
+
+            double first_error = std::abs(value_of(table_first) - exact_first);
+            double second_error = std::abs(value_of(table_second) - exact_second);
+            if (!(first_error <= first_tolerance && second_error <= second_tolerance))
+            {
+                is_cell_valid_[i * (y_count_ - 1) + j] = false;
+                invalid_cells_++;
+            }
+            else
+            {
+                max_error_[0] = std::max(max_error_[0], first_error);
+                max_error_[1] = std::max(max_error_[1], second_error);
+            }
+        }
+    }
+}
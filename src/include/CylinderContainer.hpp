@@ -1,63 +1,101 @@
-#include "Environment.hpp"
-#include "ThermodynamicObject.hpp"
-
-class CylinderContainer : public ThermodynamicObject
-{
-  bool is_tank_;
-  bool is_exposed_;
-  double pipe_length_m_;
-  double max_temperature_C_;
-  double min_temperature_C_;
-  double pipe_interior_diameter_m_;
-  double water_mass_flow_rate_kgps_;
-
-public:
-  CylinderContainer() : is_tank_(false),
-                        is_exposed_(true),
-                        pipe_length_m_(4.0),
-                        max_temperature_C_(99.0),
-                        min_temperature_C_(1.0),
-                        pipe_interior_diameter_m_(0.04),
-                        water_mass_flow_rate_kgps_(0.5) {}
-
-  CylinderContainer(bool is_tank,
-                    bool is_exposed,
-                    double length,
-                    double interior_diameter) : is_tank_(is_tank),
-                                                is_exposed_(is_exposed),
-                                                pipe_length_m_(length),
-                                                max_temperature_C_(99.0),
-                                                min_temperature_C_(1.0),
-                                                pipe_interior_diameter_m_(interior_diameter),
-                                                water_mass_flow_rate_kgps_(0.5)
-  {
-    if (is_tank)
-      thickness_m_ = 0.002; // 2 mm
-  }
-
-  void set_mass_flow_rate(double flow_rate) { water_mass_flow_rate_kgps_ = flow_rate; }
-  void set_exposed(bool exposed) { is_exposed_ = exposed; }
-  void set_pipe_length(double pipe_length) { pipe_length_m_ = pipe_length; }
-  void set_max_temperature(bool max_temperature) { max_temperature_C_ = max_temperature; }
-  void set_min_temperature(bool min_temperature) { min_temperature_C_ = min_temperature; }
-  void set_pipe_interior_diameter(bool pipe_interior_diameter)
-  {
-    pipe_interior_diameter_m_ = pipe_interior_diameter;
-  }
-  double get_thickness_m() const { return thickness_m_; }
-  double get_pipe_interior_diameter_m() { return pipe_interior_diameter_m_; }
-
-  double get_mass_kg() const override;
-  double get_volume_m3() const;
-  double get_water_mass_kg();
-  double get_flow_velocity(double temperature_C);
-  double get_pipe_surface_area_m2(bool is_inner_diameter);
-  double get_pipe_cross_sectional_area_m2(bool is_inner_diameter);
-  double get_fully_developed_velocity_in_pipe_m(double reynolds_number);
-  double get_fully_developed_temperature_in_pipe_m(double reynolds_number,
-                                                   double prandtl_number);
-  double get_air_mass_flow_rate_kgps(double tempurature_C, Environment environment, double current_time);
-  double get_cylinder_convective_coefficient_Wpm2K(double water_temperature_C, Environment environment, double current_time_s);
-  void one_second_update_temperature(double intake_water_energy_W, Environment environment, double current_time_s);
-  void add_heat_to_water(double total_energy_added_W);
-};
+#pragma once
+
+#include "Environment.hpp"
+#include "SurrogateTable.hpp"
+#include "ThermodynamicObject.hpp"
+
+class CylinderContainer : public ThermodynamicObject
+{
+  bool is_tank_;
+  bool is_exposed_;
+  Real pipe_length_m_;
+  Real max_temperature_C_;
+  Real min_temperature_C_;
+  Real pipe_interior_diameter_m_;
+  Real water_mass_flow_rate_kgps_;
+
+  // Stratified storage (tank only): index 0 is the top layer, back() the bottom (outlet) layer
+  std::vector<Real> layer_temperatures_C_;
+  std::vector<Real> layer_lower_, layer_diagonal_, layer_upper_, layer_rhs_; // Thomas solve scratch
+
+  // Optional table of solve_water_outlet() over (inlet water, wall) temperatures
+  SurrogateTable outlet_surrogate_;
+
+  static constexpr double BUOYANT_MIXING_TIME_S = 10.0;
+
+public:
+  CylinderContainer() : is_tank_(false),
+                        is_exposed_(true),
+                        pipe_length_m_(4.0),
+                        max_temperature_C_(99.0),
+                        min_temperature_C_(1.0),
+                        pipe_interior_diameter_m_(0.04),
+                        water_mass_flow_rate_kgps_(0.5) {}
+
+  CylinderContainer(bool is_tank,
+                    bool is_exposed,
+                    Real length,
+                    Real interior_diameter) : is_tank_(is_tank),
+                                                is_exposed_(is_exposed),
+                                                pipe_length_m_(length),
+                                                max_temperature_C_(99.0),
+                                                min_temperature_C_(1.0),
+                                                pipe_interior_diameter_m_(interior_diameter),
+                                                water_mass_flow_rate_kgps_(0.5)
+  {
+    if (is_tank)
+      thickness_m_ = 0.002; // 2 mm
+  }
+
+  void set_mass_flow_rate(Real flow_rate) { water_mass_flow_rate_kgps_ = flow_rate; }
+  void set_exposed(bool exposed) { is_exposed_ = exposed; }
+  void set_pipe_length(Real pipe_length) { pipe_length_m_ = pipe_length; }
+  void set_max_temperature(Real max_temperature) { max_temperature_C_ = max_temperature; }
+  void set_min_temperature(Real min_temperature) { min_temperature_C_ = min_temperature; }
+  void set_pipe_interior_diameter(Real pipe_interior_diameter)
+  {
+    pipe_interior_diameter_m_ = pipe_interior_diameter;
+  }
+  void set_layer_count(unsigned int layers);
+  Real get_thickness_m() const { return thickness_m_; }
+  bool is_stratified() const { return layer_temperatures_C_.size() > 1; }
+  Real get_top_layer_temperature_C() const
+  {
+    return is_stratified() ? layer_temperatures_C_.front() : water_temperature_C_;
+  }
+  Real get_pipe_interior_diameter_m() const { return pipe_interior_diameter_m_; }
+  Real get_mass_flow_rate_kgps() const { return water_mass_flow_rate_kgps_; }
+  bool get_exposed() const { return is_exposed_; }
+
+  Real get_mass_kg() const override;
+  void print_cache_key(std::ostream &key) const override;
+  Real get_volume_m3() const;
+  Real get_water_mass_kg();
+  Real get_flow_velocity(Real temperature_C);
+  Real get_pipe_surface_area_m2(bool is_inner_diameter);
+  Real get_pipe_cross_sectional_area_m2(bool is_inner_diameter);
+  Real get_fully_developed_velocity_in_pipe_m(Real reynolds_number);
+  Real get_fully_developed_temperature_in_pipe_m(Real reynolds_number,
+                                                   Real prandtl_number);
+  Real get_air_mass_flow_rate_kgps(Real tempurature_C, const Environment &environment, double current_time);
+  Real get_cylinder_convective_coefficient_Wpm2K(Real water_temperature_C, const Environment &environment, double current_time_s);
+  void get_environment_heat_flows_W(const Environment &environment, double current_time_s,
+                                    Real &solar_absorbtion_W, Real &heat_transfered_to_air_W);
+  Real get_water_effectiveness(Real mean_water_temperature_C);
+  void one_second_update_temperature(Real intake_water_energy_W, const Environment &environment, double current_time_s);
+  void one_second_update_surroundings(const Environment &environment, double current_time_s);
+  void one_second_update_water(Real intake_water_temperature_C);
+  void idle_update_temperature(const Environment &environment, double current_time_s, double step_s,
+                               Real source_conductance_WpK = 0.0, Real source_temperature_C = 0.0);
+  void solve_water_outlet(Real starting_water_temperature_C, Real &water_out_temperature_C, Real &heat_transfered_to_water_W);
+  void build_outlet_surrogate(double step_C, double tolerance_C);
+  const SurrogateTable &get_outlet_surrogate() const { return outlet_surrogate_; }
+  void add_heat_to_water(Real total_energy_added_W);
+  Real update_stratified_water(Real intake_water_temperature_C, double time_step_s);
+
+private:
+  static void solve_tridiagonal(const std::vector<Real> &lower,
+                                std::vector<Real> &diagonal,
+                                const std::vector<Real> &upper,
+                                std::vector<Real> &rhs);
+};
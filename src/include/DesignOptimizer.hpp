@@ -0,0 +1,84 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Simulation.hpp"
+
+// Searches bounded overrides (e.g. MASS_FLOW_RATE, PANEL_WIDTH, pipe diameters) for the design
+// that collects the most energy net of its costs:
+//     objective (kWh) = energy the returning water brings into the tank
+//                       - PUMP_POWER (W per kg/s) * mass flow rate * duration
+//                       - PANEL_COST (kWh per m^2 and day) * panel area * duration (days)
+// with Nelder-Mead over the parameter ranges scaled to [0, 1]. Each iteration evaluates the
+// reflection, expansion and both contractions concurrently and then takes the step Nelder-Mead
+// would have taken; a shrink evaluates its new vertices concurrently.
+//
+// Candidates run in CHECKPOINTS chunks. At every checkpoint the collected energy so far plus
+// Simulation::get_collection_bound_J for the rest of the run bounds the final objective; once that
+// falls below the worst vertex of the simplex the candidate would not be accepted anyway, so it is
+// stopped and scored by its bound. Parameter values are rounded to their resolution and every
+// result is memoized, so revisited designs cost nothing. Pruning thresholds only depend on the
+// simplex, so the search is the same for any number of threads.
+//
+// Spec file, one entry per line:
+//   PARAMETER MASS_FLOW_RATE 0.05 1.0 0.01   (override name, min, max, optional resolution)
+//   PUMP_POWER 150                           (W per kg/s of flow, default 0)
+//   PANEL_COST 0.05                          (kWh per m^2 of panel and simulated day, default 0)
+//   MAX_EVALUATIONS 60                       (simulation runs, default 60)
+//   CHECKPOINTS 8                            (early stopping checks per run, default 8)
+//   TOLERANCE 0.001                          (kWh between best and worst vertex to stop, default 0.001)
+//   THREADS 0                                (default 0, i.e. one per core)
+class DesignOptimizer
+{
+private:
+    struct Parameter
+    {
+        std::string name;
+        double min;
+        double max;
+        double resolution;
+    };
+
+    struct Evaluation
+    {
+        double objective_kWh;   // The bound when stopped early
+        bool is_complete;
+        double stopped_at;      // Fraction of the run simulated
+    };
+
+    using Point = std::vector<double>; // Scaled to [0, 1] per parameter
+
+    static constexpr double J_PER_KWH = 3.6e6;
+    static constexpr double S_PER_DAY = 86400.0;
+
+    const Simulation &simulation_;
+    std::vector<Parameter> parameters_;
+    double pump_power_WpKgps_;
+    double panel_cost_kWhpm2pday_;
+    unsigned int max_evaluations_;
+    unsigned int checkpoints_;
+    double tolerance_kWh_;
+    unsigned int threads_;
+
+    std::vector<unsigned long> checkpoint_times_s_;
+    std::map<std::vector<double>, Evaluation> memo_;  // By rounded parameter values
+    unsigned int evaluations_;
+    unsigned int stopped_early_;
+    unsigned int memo_hits_;
+    std::vector<double> best_values_;
+    double best_objective_kWh_;
+
+    std::vector<double> get_values(const Point &point) const;
+    Evaluation evaluate(const std::vector<double> &values, double stop_below_kWh) const;
+    std::vector<double> evaluate_all(const std::vector<Point> &points, double stop_below_kWh, std::ostream &report);
+    void print_values(std::ostream &report, const std::vector<double> &values) const;
+
+public:
+    explicit DesignOptimizer(const Simulation &simulation);
+
+    bool read_spec(const std::string &filename);
+    int run(std::ostream &report);
+    void print_result(std::ostream &output) const;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+
+#include "SolarPanel.hpp"
+
+// Neumaier (improved Kahan) summation: keeps the rounding error of every addition so that
+// millions of small per-second flows can be added to a large running total without drift
+class CompensatedSum
+{
+private:
+    Real sum_;
+    Real compensation_;
+
+public:
+    CompensatedSum() : sum_(0.0), compensation_(0.0) {}
+
+    void add(Real value)
+    {
+        Real total = sum_ + value;
+        if (abs(sum_) >= abs(value))
+            compensation_ += (sum_ - total) + value;
+        else
+            compensation_ += (value - total) + sum_;
+        sum_ = total;
+    }
+
+    Real get_value() const { return sum_ + compensation_; }
+};
+
+// Online, per component accumulation of the energy flows the engine already computes each second
+class EnergyLedger
+{
+private:
+    static constexpr int FLOW_COUNT = 6;
+    static constexpr int WIDTH = 30;
+    static constexpr int LONG_NAME_WIDTH = 35;
+    static constexpr int PRECISION = 1;
+
+    struct ComponentAccount
+    {
+        std::string name;
+        std::array<CompensatedSum, FLOW_COUNT> totals_J;
+        std::array<Real, FLOW_COUNT> interval_start_J{};
+    };
+
+    std::vector<ComponentAccount> components_;
+    CompensatedSum external_net_J_;    // Solar absorbed minus convective and radiative losses
+    CompensatedSum water_heat_input_J_; // Delivered into stored water
+
+    static std::array<Real, FLOW_COUNT> to_array(const ThermodynamicObject::EnergyFlows &flows);
+
+public:
+    size_t add_component(const std::string &name);
+    void record(size_t component, const ThermodynamicObject::EnergyFlows &flows);
+
+    Real get_external_net_J() const { return external_net_J_.get_value(); }
+    Real get_water_heat_input_J() const { return water_heat_input_J_.get_value(); }
+
+    void print_headers(std::ofstream &output_file) const;
+    void print_interval_line(std::ofstream &output_file, unsigned int time_s, Real residual_J);
+    void print_totals(std::ofstream &output_file, Real residual_J) const;
+};
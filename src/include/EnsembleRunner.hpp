@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "QuantileSketch.hpp"
+#include "Simulation.hpp"
+
+// Monte Carlo weather ensemble around one configured run. Every member is a copy of the
+// simulation with its own perturbed weather (Environment::get_perturbed, with the member number as
+// the random stream). Members run concurrently, and every logged column at every output line goes
+// into P5/P50/P95 quantile sketches, so memory grows with the log length and not with the number of
+// members. A finished member waits until the members before it have been added, which keeps the
+// (order dependent) sketches identical for any number of threads.
+class EnsembleRunner
+{
+public:
+    struct Weather
+    {
+        uint64_t seed;
+        double cloud_noise;
+        double wind_jitter_mps;
+        double ambient_jitter_C;
+    };
+
+private:
+    static constexpr std::array<double, 3> QUANTILES = {0.05, 0.5, 0.95};
+    static constexpr std::array<const char *, 3> QUANTILE_NAMES = {" P5", " P50", " P95"};
+    static constexpr int QUANTILE_NAME_WIDTH = 4;
+
+    using Sketches = std::array<QuantileSketch, QUANTILES.size()>;
+
+    const Simulation &simulation_;
+    unsigned int members_;
+    Weather weather_;
+    std::vector<unsigned long> output_times_s_;
+    std::vector<Simulation::LoggedColumn> columns_; // Layout of every logged line
+    std::vector<Sketches> sketches_;                // Output line major, then column (time excluded)
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_turn_;
+    unsigned int next_member_to_merge_;
+
+    std::vector<double> run_member(unsigned int member, bool is_implicit) const;
+    void merge(unsigned int member, const std::vector<double> &values);
+
+public:
+    EnsembleRunner(const Simulation &simulation, unsigned int members, const Weather &weather);
+
+    // Runs every member on up to `threads` threads, then writes one line of quantiles per output line
+    void run(std::ostream &output_file, bool is_implicit, unsigned int threads);
+};
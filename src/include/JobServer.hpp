@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+
+#include "Simulation.hpp"
+
+// Long-lived job server: reads newline-delimited JSON job descriptions from stdin, runs them on a
+// pool of worker threads and writes one JSON result line per job to stdout as each one completes.
+// Parsed weather files stay cached for the lifetime of the server, so repeated jobs skip startup
+// and input parsing entirely.
+//
+// Job:    {"id": "a1", "weather": "input/environment.txt",
+//          "overrides": {"SIMULATION_DURATION": 3600, "MASS_FLOW_RATE": 0.4},
+//          "output": "output/a1.txt"}
+// Result: {"id": "a1", "status": "ok", "output": "output/a1.txt", "wall_time_s": 0.021}
+// Without "output" the log is returned inline in the result as "log".
+class JobServer
+{
+public:
+    // Just enough JSON for job descriptions: objects, arrays, strings, numbers, booleans and null
+    struct JsonValue
+    {
+        enum class Type { Null, Boolean, Number, String, Array, Object } type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::vector<std::pair<std::string, JsonValue>> object; // In document order: overrides apply in that order
+
+        const JsonValue *find(const std::string &key) const; // The last member with that key
+    };
+
+    static bool parse_json(const std::string &text, JsonValue &value);
+    static std::string escape_json(const std::string &text);
+
+private:
+    struct Job
+    {
+        std::string id;
+        std::string weather_filename;
+        std::string output_filename;
+        std::vector<std::pair<std::string, double>> overrides;
+        std::string error; // Set if the description is unusable; the job only reports it
+    };
+
+    std::queue<Job> jobs_;
+    bool is_input_closed_ = false;
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_available_;
+
+    std::map<std::string, std::shared_ptr<const Environment>> weather_cache_;
+    std::mutex weather_mutex_;
+
+    std::mutex output_mutex_;
+
+    std::shared_ptr<const Environment> get_weather(const std::string &filename);
+    void worker();
+    std::string run_job(const Job &job);
+    void write_result(const std::string &result_line);
+
+public:
+    int serve(std::istream &input, unsigned int worker_count);
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+
+#include "SolarPanel.hpp"
+
+// Fully coupled backward Euler step of the whole water loop, for time steps far longer than the
+// one second the sequential component updates are stable at.
+//
+// Unknowns are the end-of-step temperatures of the five solids and the tank water. The water
+// leaving each component follows algebraically from its wall temperature through the pipe's
+// exchanger effectiveness (frozen at the start of the step), so the loop closes in one system:
+//     T_out = T_in + effectiveness * (T_wall - T_in)
+// The system is solved by Newton iteration on a finite difference Jacobian. Its LU factorization
+// is reused across iterations and steps (chord iterations) until convergence slows down or the
+// step size changes. The Jacobian is built from values only; in dual-number builds the chord
+// iterations still converge the derivative parts of the solution.
+//
+// Temperature clamps of the sequential model are not applied inside the coupled solve.
+class LoopSolver
+{
+public:
+    enum Unknown
+    {
+        TANK_WALL,
+        TANK_WATER,
+        PIPE_TO_PANEL,
+        PANEL,
+        PIPE_ON_PANEL,
+        PIPE_TO_TANK,
+        UNKNOWN_COUNT
+    };
+
+    using State = std::array<Real, UNKNOWN_COUNT>;
+    using Matrix = std::array<std::array<double, UNKNOWN_COUNT>, UNKNOWN_COUNT>;
+    using Pivots = std::array<size_t, UNKNOWN_COUNT>;
+
+private:
+    static constexpr int MAX_ITERATIONS = 25;
+    static constexpr double TEMPERATURE_THRESHOLD_C = 1e-7;
+    static constexpr double SLOW_CONTRACTION_RATIO = 0.5; // Refactor when an iteration shrinks the update less
+    static constexpr double JACOBIAN_STEP_C = 1e-5;
+
+    // Components of the step being solved
+    const Environment *environment_;
+    CylinderContainer *tank_, *pipe_to_panel_, *pipe_on_panel_, *pipe_to_tank_;
+    SolarPanel *solar_panel_;
+    double end_time_s_;
+    double time_step_s_;
+
+    // Frozen over one step
+    State previous_;
+    std::array<Real, UNKNOWN_COUNT> heat_capacity_JpK_;
+    std::array<Real, 4> effectiveness_;    // Tank, pipe to panel, pipe on panel, pipe to tank
+    std::array<Real, 4> capacity_rate_WpK_; // Mass flow * specific heat, same order
+    Real tank_inflow_capacity_rate_WpK_;
+
+    // Reused factorization
+    Matrix lu_;
+    Pivots pivots_;
+    bool is_factorized_;
+    double factorized_time_step_s_;
+
+    unsigned long steps_, iterations_, factorizations_, unconverged_steps_;
+
+    void apply(const State &x);
+    void get_outlet_temperatures_C(const State &x, std::array<Real, 4> &outlets) const;
+    void evaluate_residual(const State &x, State &residual);
+    void factorize(const State &x);
+    void record_energy_flows(const State &x);
+
+public:
+    LoopSolver() : environment_(nullptr),
+                   tank_(nullptr),
+                   pipe_to_panel_(nullptr),
+                   pipe_on_panel_(nullptr),
+                   pipe_to_tank_(nullptr),
+                   solar_panel_(nullptr),
+                   end_time_s_(0.0),
+                   time_step_s_(0.0),
+                   is_factorized_(false),
+                   factorized_time_step_s_(0.0),
+                   steps_(0),
+                   iterations_(0),
+                   factorizations_(0),
+                   unconverged_steps_(0) {}
+
+    // Advances every component by time_step_s starting at current_time_s
+    void step(const Environment &environment,
+              CylinderContainer &tank,
+              CylinderContainer &pipe_to_panel,
+              SolarPanel &solar_panel,
+              CylinderContainer &pipe_on_panel,
+              CylinderContainer &pipe_to_tank,
+              double current_time_s,
+              double time_step_s);
+
+    void print_statistics(std::ostream &output) const;
+
+    // LU factorization with partial pivoting in place (P * A = L * U, rows swapped whole)
+    static void factorize_matrix(Matrix &lu, Pivots &pivots);
+
+    // Solves A * x = rhs in place with a factorization from factorize_matrix
+    static void solve_factorized(const Matrix &lu, const Pivots &pivots, State &rhs);
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+// Optional 2D thermal field of the absorber plate, replacing the lumped panel temperature.
+// Cells exchange heat with their four neighbours by in-plane conduction (edges insulated), gain
+// sun at their own temperature dependent efficiency, lose heat to the air by convection and
+// radiation, and the cells under the pipe conduct into the (lumped) pipe on the panel. The pipe
+// runs in evenly spaced passes along the length of the panel, and the lumped model's panel to
+// pipe conductance is shared between the cells it covers, so a uniform field behaves exactly like
+// the lumped panel; lateral conduction to the pipe is what the grid adds.
+//
+// Temperatures are plain doubles in a grid padded by one halo cell on every side, so the explicit
+// stencil sweep is a straight loop over each row that the compiler vectorizes (see Makefile).
+class PanelGrid
+{
+public:
+    // Uniform over the plate during one update
+    struct Conditions
+    {
+        double irradiance_Wpm2;
+        double ambient_temperature_C;
+        double convective_coefficient_Wpm2K;
+        double pipe_temperature_C;
+        double ideal_efficiency;
+        double efficiency_coefficient;
+        double max_ideal_temperature_C;
+        double min_efficiency;
+        double emissivity;
+    };
+
+    // Whole plate totals over one update (W)
+    struct Flows
+    {
+        double solar_W = 0.0;
+        double radiative_loss_W = 0.0;
+        double convective_loss_air_W = 0.0;
+        double conductive_loss_to_pipe_W = 0.0;
+    };
+
+private:
+    static constexpr double STEFAN_BOLTZMANN_CONST_WPM2K4 = 5.67e-8; // W / (m^2 * K^4)
+
+    size_t length_cells_, width_cells_, stride_;
+    double cell_area_m2_;
+    double cell_heat_capacity_JpK_;
+    double length_conductance_WpK_; // Between neighbours along the length
+    double width_conductance_WpK_;  // Between neighbours across the width
+    double max_stable_step_s_;
+    std::vector<double> temperatures_C_, next_temperatures_C_;
+    std::vector<double> pipe_conductance_WpK_; // Per cell, zero away from the pipe
+
+    void fill_halo();
+    void sweep(double step_s, const Conditions &conditions, Flows &flows);
+
+public:
+    PanelGrid() : length_cells_(0),
+                  width_cells_(0),
+                  stride_(0),
+                  cell_area_m2_(0.0),
+                  cell_heat_capacity_JpK_(0.0),
+                  length_conductance_WpK_(0.0),
+                  width_conductance_WpK_(0.0),
+                  max_stable_step_s_(0.0) {}
+
+    bool empty() const { return temperatures_C_.empty(); }
+
+    void build(size_t cells,
+               double length_m,
+               double width_m,
+               double thickness_m,
+               double heat_capacity_JpKm3,
+               double thermal_conductivity_WpmK,
+               double pipe_length_m,
+               double pipe_conductance_WpK,
+               double temperature_C);
+
+    // Advances the field by time_step_s (in stable sub-steps); flows are averaged over the update
+    Flows update(double time_step_s, const Conditions &conditions);
+
+    double get_mean_temperature_C() const;
+    double get_max_temperature_C() const;
+};
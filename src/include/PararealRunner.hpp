@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Simulation.hpp"
+
+// Parallel-in-time (parareal) execution of one long run. The run is cut into slices that end on
+// output lines. A cheap coarse propagator G (implicit loop solves with long steps) predicts the
+// state at every slice boundary; the fine propagator F (the regular per-second updates) then
+// refines all slices concurrently, and the boundaries are corrected serially:
+//     U[n + 1] = G(U_new[n]) + F(U_old[n]) - G(U_old[n])
+// until no boundary moves by more than the tolerance. After k iterations the first k slices are
+// exact, so at most one iteration per slice is ever needed. The log is assembled from the fine
+// sweep of each slice and matches the serial run to within the tolerance.
+class PararealRunner
+{
+private:
+    using LoopState = Simulation::LoopState;
+
+    const Simulation &simulation_;
+    Simulation coarse_;
+    std::vector<unsigned long> boundaries_s_; // Slice n covers (boundaries_s_[n], boundaries_s_[n + 1]]
+    double tolerance_C_;
+
+    LoopState propagate_coarse(const LoopState &start, size_t slice);
+
+public:
+    PararealRunner(const Simulation &simulation,
+                   unsigned int slices,
+                   unsigned int coarse_step_s,
+                   double tolerance_C);
+
+    // Logs every output line after time zero; is_implicit selects the fine propagator's solver.
+    // Progress is reported at the converged slice boundary after every iteration
+    void run(std::ostream &output_file, bool is_implicit, ProgressReporter &progress_reporter);
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+
+// Periodic progress for long runs: simulated time, wall time, simulated seconds per wall second,
+// ETA and output bytes, written to stderr or to an atomically replaced Prometheus text file.
+// The wall clock is only consulted every TICKS_PER_CLOCK_CHECK ticks, so a disabled or coarse
+// reporter costs one decrement and branch per simulated second.
+class ProgressReporter
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr unsigned int TICKS_PER_CLOCK_CHECK = 1024;
+
+    double interval_s_;
+    std::string metrics_filename_; // Empty: report to stderr
+    unsigned long duration_s_;
+    unsigned int ticks_until_clock_check_;
+    Clock::time_point start_;
+    Clock::time_point next_report_;
+
+    void report(unsigned long simulated_s, std::ostream &output_file, bool is_done);
+
+public:
+    ProgressReporter() : interval_s_(0.0),
+                         duration_s_(0),
+                         ticks_until_clock_check_(TICKS_PER_CLOCK_CHECK) {}
+
+    void start(double interval_s, const std::string &metrics_filename, unsigned long duration_s);
+
+    void on_tick(unsigned long simulated_s, std::ostream &output_file)
+    {
+        if (interval_s_ <= 0.0 || --ticks_until_clock_check_ != 0)
+            return;
+        ticks_until_clock_check_ = TICKS_PER_CLOCK_CHECK;
+        if (Clock::now() >= next_report_)
+            report(simulated_s, output_file, /*is_done*/ false);
+    }
+
+    // For runs that move in large jumps (e.g. parareal iterations): checks the clock on every call
+    void on_jump(unsigned long simulated_s, std::ostream &output_file)
+    {
+        if (interval_s_ > 0.0 && Clock::now() >= next_report_)
+            report(simulated_s, output_file, /*is_done*/ false);
+    }
+
+    void finish(unsigned long simulated_s, std::ostream &output_file)
+    {
+        if (interval_s_ > 0.0)
+            report(simulated_s, output_file, /*is_done*/ true);
+    }
+};
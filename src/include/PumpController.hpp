@@ -0,0 +1,65 @@
+#pragma once
+
+#include <ostream>
+
+// Decides each second whether the circulation pump runs. By default it always does. A
+// differential thermostat switches it on once the panel is PUMP_ON_DIFFERENTIAL above the tank
+// water (the bottom layer, where the supply is drawn) and off again below PUMP_OFF_DIFFERENTIAL.
+// A daily time window (seconds of the day, simulation time 0 being midnight) keeps it off outside
+// the window, and can wrap past midnight. While the pump is off the loop advances in idle steps;
+// the simulation cuts an idle step at the second the thermostat would switch the pump on
+// (would_switch_on), so switch on times do not depend on the idle step length.
+class PumpController
+{
+private:
+    static constexpr unsigned long SECONDS_PER_DAY = 86400;
+
+    bool is_differential_;
+    double on_differential_C_;
+    double off_differential_C_;
+    unsigned long window_start_s_;
+    unsigned long window_end_s_; // Equal to the start: no window
+    bool is_on_;
+
+    unsigned long switches_;
+    unsigned long on_time_s_;
+    unsigned long off_time_s_;
+    unsigned long idle_steps_;
+
+    bool has_window() const { return window_start_s_ != window_end_s_; }
+    bool is_in_window(unsigned long time_s) const;
+
+public:
+    PumpController() : is_differential_(false),
+                       on_differential_C_(8.0),
+                       off_differential_C_(3.0),
+                       window_start_s_(0),
+                       window_end_s_(0),
+                       is_on_(false),
+                       switches_(0),
+                       on_time_s_(0),
+                       off_time_s_(0),
+                       idle_steps_(0) {}
+
+    void set_differential(bool is_differential) { is_differential_ = is_differential; }
+    void set_on_differential(double on_differential_C) { on_differential_C_ = on_differential_C; }
+    void set_off_differential(double off_differential_C) { off_differential_C_ = off_differential_C; }
+    void set_window_start(unsigned long window_start_s) { window_start_s_ = window_start_s % SECONDS_PER_DAY; }
+    void set_window_end(unsigned long window_end_s) { window_end_s_ = window_end_s % SECONDS_PER_DAY; }
+
+    bool is_enabled() const { return is_differential_ || has_window(); }
+    bool is_on() const { return is_on_; }
+
+    // Switches the pump for the second starting at time_s and returns whether it runs
+    bool update(unsigned long time_s, double panel_temperature_C, double tank_water_temperature_C);
+    // Whether update would switch a stopped pump on at time_s, without switching it
+    bool would_switch_on(unsigned long time_s, double panel_temperature_C, double tank_water_temperature_C) const;
+    // Seconds from time_s until the window next opens (0 when it is open or there is none)
+    unsigned long get_seconds_to_window_open(unsigned long time_s) const;
+    void record_idle_step(unsigned long step_s);
+    void record_running_second() { on_time_s_++; }
+
+    void print_statistics(std::ostream &output) const;
+    // Settings the log depends on, space separated (see Simulation::get_cache_key)
+    void print_cache_key(std::ostream &key) const;
+};
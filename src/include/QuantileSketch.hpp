@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Streaming estimate of one quantile in constant memory: the P-square algorithm (Jain & Chlamtac,
+// 1985). Five markers track the minimum, the quantile, the maximum and the points halfway
+// between. As values arrive, the markers move toward their ideal ranks and their heights follow a
+// piecewise parabolic fit. The first EXACT_VALUES values are kept, so small samples get the exact
+// quantile and the markers start at the right ranks instead of creeping there from the middle.
+// The estimate depends on the order the values arrive in, so add them in a fixed order when
+// results must be reproducible.
+class QuantileSketch
+{
+private:
+    static constexpr size_t MARKERS = 5;
+    static constexpr size_t EXACT_VALUES = 16;
+
+    double quantile_;
+    size_t count_;
+    std::array<double, EXACT_VALUES> heights_; // The values (sorted) until there are more than EXACT_VALUES,
+                                               // then the marker heights in the first MARKERS
+    std::array<double, MARKERS> positions_;    // Ranks of the markers, from 1
+
+    std::array<double, MARKERS> get_rank_fractions() const;
+    void start_markers();
+    double get_parabolic_height(size_t marker, double direction) const;
+    double get_linear_height(size_t marker, double direction) const;
+
+public:
+    explicit QuantileSketch(double quantile = 0.5) : quantile_(quantile),
+                                                     count_(0),
+                                                     heights_(),
+                                                     positions_() {}
+
+    void add(double value);
+    double get() const;
+    size_t get_count() const { return count_; }
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <ostream>
+
+// Scalar used for every physical quantity. Normally a plain double; building with
+// SENSITIVITY_PARAMETERS=<n> (see Makefile) turns it into a forward-mode dual number that carries
+// the derivative with respect to up to <n> seeded override parameters through the whole simulation.
+//
+// Comparisons only look at the value, so branches and std::clamp pick the active formula and the
+// derivative is that of the selected branch (zero when clamped to a constant bound).
+
+using std::abs;
+using std::exp;
+using std::pow;
+using std::sqrt;
+using std::tanh;
+
+#ifdef SENSITIVITY_PARAMETERS
+
+template <int N>
+class Dual
+{
+public:
+    double value;
+    std::array<double, N> gradient;
+
+    Dual(double val = 0.0) : value(val), gradient{} {}
+
+    static Dual seeded(double val, int parameter_index)
+    {
+        Dual dual(val);
+        dual.gradient[parameter_index] = 1.0;
+        return dual;
+    }
+
+    explicit operator double() const { return value; }
+
+    Dual &operator+=(const Dual &other)
+    {
+        value += other.value;
+        for (int i = 0; i < N; i++)
+            gradient[i] += other.gradient[i];
+        return *this;
+    }
+    Dual &operator-=(const Dual &other)
+    {
+        value -= other.value;
+        for (int i = 0; i < N; i++)
+            gradient[i] -= other.gradient[i];
+        return *this;
+    }
+    Dual &operator*=(const Dual &other)
+    {
+        for (int i = 0; i < N; i++)
+            gradient[i] = gradient[i] * other.value + value * other.gradient[i];
+        value *= other.value;
+        return *this;
+    }
+    Dual &operator/=(const Dual &other)
+    {
+        double inverse = 1.0 / other.value;
+        value *= inverse;
+        for (int i = 0; i < N; i++)
+            gradient[i] = (gradient[i] - value * other.gradient[i]) * inverse;
+        return *this;
+    }
+};
+
+// Result of a unary function f(x) given f(value) and f'(value)
+template <int N>
+Dual<N> chain(const Dual<N> &x, double function_value, double derivative)
+{
+    Dual<N> result(function_value);
+    for (int i = 0; i < N; i++)
+        result.gradient[i] = derivative * x.gradient[i];
+    return result;
+}
+
+template <int N> Dual<N> operator-(const Dual<N> &x) { return chain(x, -x.value, -1.0); }
+template <int N> Dual<N> operator+(Dual<N> a, const Dual<N> &b) { return a += b; }
+template <int N> Dual<N> operator-(Dual<N> a, const Dual<N> &b) { return a -= b; }
+template <int N> Dual<N> operator*(Dual<N> a, const Dual<N> &b) { return a *= b; }
+template <int N> Dual<N> operator/(Dual<N> a, const Dual<N> &b) { return a /= b; }
+template <int N> Dual<N> operator+(Dual<N> a, double b) { return a += Dual<N>(b); }
+template <int N> Dual<N> operator-(Dual<N> a, double b) { return a -= Dual<N>(b); }
+template <int N> Dual<N> operator*(Dual<N> a, double b) { return chain(a, a.value * b, b); }
+template <int N> Dual<N> operator/(Dual<N> a, double b) { return chain(a, a.value / b, 1.0 / b); }
+template <int N> Dual<N> operator+(double a, const Dual<N> &b) { return b + a; }
+template <int N> Dual<N> operator-(double a, const Dual<N> &b) { return Dual<N>(a) - b; }
+template <int N> Dual<N> operator*(double a, const Dual<N> &b) { return b * a; }
+template <int N> Dual<N> operator/(double a, const Dual<N> &b) { return Dual<N>(a) / b; }
+
+template <int N> bool operator<(const Dual<N> &a, const Dual<N> &b) { return a.value < b.value; }
+template <int N> bool operator>(const Dual<N> &a, const Dual<N> &b) { return a.value > b.value; }
+template <int N> bool operator<=(const Dual<N> &a, const Dual<N> &b) { return a.value <= b.value; }
+template <int N> bool operator>=(const Dual<N> &a, const Dual<N> &b) { return a.value >= b.value; }
+template <int N> bool operator==(const Dual<N> &a, const Dual<N> &b) { return a.value == b.value; }
+template <int N> bool operator!=(const Dual<N> &a, const Dual<N> &b) { return a.value != b.value; }
+template <int N> bool operator<(const Dual<N> &a, double b) { return a.value < b; }
+template <int N> bool operator>(const Dual<N> &a, double b) { return a.value > b; }
+template <int N> bool operator<=(const Dual<N> &a, double b) { return a.value <= b; }
+template <int N> bool operator>=(const Dual<N> &a, double b) { return a.value >= b; }
+template <int N> bool operator<(double a, const Dual<N> &b) { return a < b.value; }
+template <int N> bool operator>(double a, const Dual<N> &b) { return a > b.value; }
+template <int N> bool operator<=(double a, const Dual<N> &b) { return a <= b.value; }
+template <int N> bool operator>=(double a, const Dual<N> &b) { return a >= b.value; }
+
+template <int N>
+Dual<N> pow(const Dual<N> &x, double exponent)
+{
+    double power = std::pow(x.value, exponent);
+    return chain(x, power, exponent == 0.0 ? 0.0 : exponent * std::pow(x.value, exponent - 1.0));
+}
+template <int N> Dual<N> exp(const Dual<N> &x) { double e = std::exp(x.value); return chain(x, e, e); }
+template <int N> Dual<N> sqrt(const Dual<N> &x) { double r = std::sqrt(x.value); return chain(x, r, 0.5 / r); }
+template <int N> Dual<N> abs(const Dual<N> &x) { return chain(x, std::abs(x.value), x.value < 0.0 ? -1.0 : 1.0); }
+template <int N>
+Dual<N> tanh(const Dual<N> &x)
+{
+    double t = std::tanh(x.value);
+    return chain(x, t, 1.0 - t * t);
+}
+
+template <int N>
+std::ostream &operator<<(std::ostream &stream, const Dual<N> &x) { return stream << x.value; }
+
+using Real = Dual<SENSITIVITY_PARAMETERS>;
+
+inline double value_of(const Real &x) { return x.value; }
+inline double derivative_of(const Real &x, int parameter_index) { return x.gradient[parameter_index]; }
+inline Real seeded_real(double value, int parameter_index) { return Real::seeded(value, parameter_index); }
+
+#else
+
+using Real = double;
+
+inline double value_of(double x) { return x; }
+inline double derivative_of(double, int) { return 0.0; }
+inline Real seeded_real(double value, int) { return value; }
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// On-disk cache of finished runs, content addressed: an entry is named by a digest of everything
+// that determines the log apart from the duration (the engine version, the weather data and the
+// effective overrides, see Simulation::get_cache_key), followed by the duration. Entries of runs
+// whose loop state is complete also hold the state they ended in, so a longer run with the same
+// key resumes from the longest one instead of starting over.
+//
+// Lookups touch the entry they use and stores evict the least recently used entries until the
+// cache is within max_bytes. Hit, miss, resume and eviction counts persist in stats.txt. Files are
+// written under a temporary name and renamed, so other processes never read a partial entry;
+// within a process one mutex serializes every cache operation (e.g. concurrent server jobs). The
+// statistics update and the eviction also hold an exclusive lock on the cache's lock file, so
+// processes sharing the directory do not lose each other's counts (on Windows, where there is no
+// such lock, the counts are best effort).
+class ResultCache
+{
+public:
+    static constexpr const char *DEFAULT_DIRECTORY = "cache";
+    static constexpr const char *ENGINE_VERSION = "3"; // Bump whenever a change alters logged results
+
+    struct Entry
+    {
+        unsigned long duration_s;
+        std::string log;
+        std::vector<double> state; // Empty: the run cannot be resumed
+    };
+
+    enum class Outcome
+    {
+        HIT,
+        RESUMED,
+        MISS
+    };
+
+    struct Statistics
+    {
+        unsigned long hits = 0;
+        unsigned long misses = 0;
+        unsigned long resumes = 0;
+        unsigned long evictions = 0;
+    };
+
+private:
+    static constexpr const char *ENTRY_EXTENSION = ".entry";
+    static constexpr const char *STATISTICS_FILENAME = "stats.txt";
+    static constexpr const char *LOCK_FILENAME = "lock";
+
+    static std::mutex mutex_;
+
+    std::filesystem::path directory_;
+    uintmax_t max_bytes_;
+
+    std::filesystem::path get_entry_path(const std::string &key, unsigned long duration_s) const;
+    bool read_entry(const std::filesystem::path &path, const std::string &key, Entry &entry) const;
+    bool write_file(const std::filesystem::path &path, const std::string &content) const;
+    Statistics read_statistics() const;
+    void write_statistics(const Statistics &statistics) const;
+    unsigned long evict();
+
+public:
+    ResultCache(const std::string &directory, uintmax_t max_bytes);
+
+    static std::string get_digest(const std::string &text);
+
+    bool find(const std::string &key, unsigned long duration_s, Entry &entry);
+    // Resumable entry with the longest duration short of duration_s
+    bool find_longest_prefix(const std::string &key, unsigned long duration_s, Entry &entry);
+    void store(const std::string &key, const Entry &entry);
+
+    void record(Outcome outcome, std::ostream &output);
+    Statistics get_statistics();
+    void print_summary(std::ostream &output);
+};
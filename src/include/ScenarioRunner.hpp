@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <map>
+
+#include "Simulation.hpp"
+
+// Runs every scenario directory under a corpus root and compares the resulting log against the
+// recorded golden output (per column tolerances) and against the wall time and peak memory budgets.
+//
+// Each scenario directory contains:
+//   overrides.txt      simulation overrides (same format as input/overrides.txt)
+//   environment.txt    weather (same format as input/environment.txt)
+//   expected_log.txt   golden simulation_log.txt
+//   scenario.txt       budgets and tolerances, one "NAME value" per line:
+//                        MAX_WALL_TIME_S 2.0
+//                        MAX_PEAK_RSS_KB 16384
+//                        DEFAULT_TOLERANCE 0.01
+//                        COLUMN_TOLERANCE 5 0.05   (column index from 0, absolute tolerance)
+//   expected_log_ensemble.txt  optional golden side output, compared at DEFAULT_TOLERANCE
+//   optimize.txt       optional design optimizer spec (see DesignOptimizer): the scenario searches
+//                      from its overrides and weather, and the log is the search's one row result
+//   cache_runs.txt     optional result cache runs, one "duration [NAME value ...]" per line: the
+//                      scenario replays them against an empty cache of its own, and the log holds
+//                      the cache counts after each run and whether it matched an uncached run
+//   linear_systems.txt optional 6 x 6 systems for the implicit loop solver's LU factorization, one
+//                      per line (matrix row by row, then the right hand side): the log holds each
+//                      solution instead of a simulation
+class ScenarioRunner
+{
+private:
+    struct ScenarioSpec
+    {
+        double max_wall_time_s = 60.0;
+        long max_peak_rss_kb = 65536;
+        double default_tolerance = 0.01;
+        std::map<size_t, double> column_tolerances;
+    };
+
+    struct RunResult
+    {
+        bool completed = false;
+        double wall_time_s = 0.0;
+        long peak_rss_kb = 0;
+    };
+
+    struct Comparison
+    {
+        bool matches = false;
+        std::string message;
+        double worst_tolerance_use = 0.0; // Largest |deviation| / tolerance over all cells
+    };
+
+    static constexpr int NAME_WIDTH = 32;
+    static constexpr std::array<const char *, 1> SIDE_OUTPUT_SUFFIXES = {"_ensemble.txt"};
+
+    ScenarioSpec read_spec(const std::string &filename) const;
+    RunResult run_scenario(const std::string &directory, const std::string &output_filename) const;
+    Comparison compare_logs(const std::string &expected_filename,
+                            const std::string &actual_filename,
+                            const ScenarioSpec &spec) const;
+
+public:
+    int run_all(const std::string &corpus_directory, const std::string &name_filter, bool record_golden);
+};
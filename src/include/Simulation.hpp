@@ -1,39 +1,169 @@
-#include "SolarPanel.hpp"
-
-class Simulation
-{
-private:
-    Environment environment_;
-    SolarPanel solar_panel_;
-    CylinderContainer pipe_into_panel_,
-                      pipe_into_tank_,
-                      pipe_on_panel_ = CylinderContainer(/*is_tank*/ false,
-                                                         /*is_exposed*/ false,
-                                                         /*length_m*/ 4.0,
-                                                         /*diameter_m*/ 0.04),
-                      tank_ = CylinderContainer(/*is_tank*/ true,
-                                                /*is_exposed*/ true,
-                                                /*length_m*/ 2.0,
-                                                /*diameter_m*/ 1.0);
-    unsigned long duration_s_;
-    unsigned int time_step_s_;
-    unsigned int current_time_s_;
-
-    static constexpr int FIRST_WIDTH = 10;
-    static constexpr int SHORT_WIDTH = 15;
-    static constexpr int MEDIUM_WIDTH = 20;
-    static constexpr int LONG_WIDTH = 25;
-    static constexpr int PRECISION = 2;
-
-public:
-    Simulation() : duration_s_(3600),
-                   time_step_s_(60.0),
-                   current_time_s_(0.0) {}
-
-    void print_headers(std::ofstream &output_file);
-    void print_data_line(std::ofstream &output_file);
-    void read_simulation_constants(const std::string &filename);
-    void run_simulation(const std::string &sim_overrides_file,
-                        const std::string &environmental_file,
-                        const std::string &output_filename);
-};
+#pragma once
+
+#include "EnergyLedger.hpp"
+#include "LoopSolver.hpp"
+#include "ProgressReporter.hpp"
+#include "PumpController.hpp"
+#include "ResultCache.hpp"
+
+class Simulation
+{
+public:
+    // Everything a later step depends on: wall temperatures of the five solids, then the water
+    // temperature and water out temperature of the tank and each pipe
+    static constexpr size_t LOOP_STATE_SIZE = 13;
+    using LoopState = std::array<Real, LOOP_STATE_SIZE>;
+
+    // One per component in pipelined runs; fewer cores fall back to a sequential run
+    static constexpr unsigned int PIPELINE_THREADS = 4;
+
+    struct LoggedColumn
+    {
+        const char *name;
+        int name_width;
+        int value_width;
+        int precision;
+        double value;
+    };
+
+private:
+    Environment environment_;
+    SolarPanel solar_panel_;
+    CylinderContainer pipe_into_panel_,
+                      pipe_into_tank_,
+                      pipe_on_panel_ = CylinderContainer(/*is_tank*/ false,
+                                                         /*is_exposed*/ false,
+                                                         /*length_m*/ 4.0,
+                                                         /*diameter_m*/ 0.04),
+                      tank_ = CylinderContainer(/*is_tank*/ true,
+                                                /*is_exposed*/ true,
+                                                /*length_m*/ 2.0,
+                                                /*diameter_m*/ 1.0);
+    unsigned long duration_s_;
+    unsigned int time_step_s_;
+    unsigned int current_time_s_;
+    unsigned int tank_layers_;
+    bool is_energy_ledger_enabled_;
+    EnergyLedger energy_ledger_;
+    Real initial_stored_energy_J_;
+    Real collected_energy_J_; // Heat the returning water has brought into the tank so far
+    std::vector<std::string> sensitivity_parameters_; // Index is the derivative slot
+    double progress_interval_s_;
+    bool is_progress_prometheus_;
+    ProgressReporter progress_reporter_;
+    bool is_implicit_solver_;
+    unsigned int implicit_time_step_s_;
+    LoopSolver loop_solver_;
+    unsigned int panel_grid_cells_;
+    Real panel_conductivity_WpmK_;
+    bool is_outlet_surrogate_enabled_;
+    double outlet_surrogate_step_C_;
+    double outlet_surrogate_tolerance_C_;
+    unsigned int parareal_slices_;
+    unsigned int parareal_coarse_step_s_;
+    double parareal_tolerance_C_;
+    bool is_pipelined_;
+    unsigned int ensemble_members_;
+    unsigned int ensemble_threads_;
+    uint64_t ensemble_seed_;
+    double ensemble_cloud_noise_;
+    double ensemble_wind_jitter_mps_;
+    double ensemble_ambient_jitter_C_;
+    PumpController pump_controller_;
+    unsigned int pump_idle_step_s_;
+    bool is_result_cache_enabled_;
+    double result_cache_max_MB_;
+    std::string result_cache_directory_;
+    double stream_realtime_factor_;
+    double stream_latency_budget_ms_;
+
+    static constexpr int FIRST_WIDTH = 10;
+    static constexpr int SHORT_WIDTH = 15;
+    static constexpr int MEDIUM_WIDTH = 20;
+    static constexpr int LONG_WIDTH = 25;
+    static constexpr int PRECISION = 2;
+
+    unsigned long get_seconds_to_output_line() const;
+    unsigned int advance(bool is_implicit, unsigned long end_time_s);
+    unsigned int advance_idle(unsigned long end_time_s);
+    void run_uncached(std::ostream &output_file, const std::string &output_filename);
+    void propagate_pipelined(std::ostream &output_file);
+
+public:
+    Simulation() : duration_s_(3600),
+                   time_step_s_(60.0),
+                   current_time_s_(0.0),
+                   tank_layers_(1),
+                   is_energy_ledger_enabled_(false),
+                   initial_stored_energy_J_(0.0),
+                   collected_energy_J_(0.0),
+                   progress_interval_s_(0.0),
+                   is_progress_prometheus_(false),
+                   is_implicit_solver_(false),
+                   implicit_time_step_s_(60),
+                   panel_grid_cells_(0),
+                   panel_conductivity_WpmK_(40.0),
+                   is_outlet_surrogate_enabled_(false),
+                   outlet_surrogate_step_C_(1.0),
+                   outlet_surrogate_tolerance_C_(0.01),
+                   parareal_slices_(0),
+                   parareal_coarse_step_s_(600),
+                   parareal_tolerance_C_(1e-4),
+                   is_pipelined_(false),
+                   ensemble_members_(0),
+                   ensemble_threads_(0),
+                   ensemble_seed_(1),
+                   ensemble_cloud_noise_(0.2),
+                   ensemble_wind_jitter_mps_(1.0),
+                   ensemble_ambient_jitter_C_(1.0),
+                   pump_idle_step_s_(60),
+                   is_result_cache_enabled_(false),
+                   result_cache_max_MB_(256.0),
+                   result_cache_directory_(ResultCache::DEFAULT_DIRECTORY),
+                   stream_realtime_factor_(0.0),
+                   stream_latency_budget_ms_(100.0) {}
+
+    std::vector<LoggedColumn> get_logged_columns() const;
+    void print_headers(std::ostream &output_file);
+    void print_data_line(std::ostream &output_file);
+    bool apply_override(const std::string &name, Real value);
+    void finalize_constants();
+    void read_simulation_constants(const std::string &filename);
+    void set_environment(const Environment &environment) { environment_ = environment; }
+    const Environment &get_environment() const { return environment_; }
+    void set_result_cache_directory(const std::string &directory) { result_cache_directory_ = directory; }
+    void build_outlet_surrogates();
+    void register_energy_accounts();
+    void record_energy_flows();
+    void read_sensitivity_parameters(const std::string &filename);
+    void print_sensitivities(std::ofstream &output_file);
+    Real get_stored_energy_J() const;
+    Real get_energy_residual_J() const;
+    Real get_collected_energy_J() const { return collected_energy_J_; }
+    Real get_mass_flow_rate_kgps() const { return tank_.get_mass_flow_rate_kgps(); }
+    Real get_panel_area_m2() const { return solar_panel_.get_surface_area_m2(); }
+    Real get_collection_bound_J(unsigned long end_time_s);
+    void run_simulation(const std::string &sim_overrides_file,
+                        const std::string &environmental_file,
+                        const std::string &output_filename);
+    bool prepare_components(bool is_parareal);
+    void run(std::ostream &output_file, const std::string &output_filename);
+    std::string get_cache_key() const;
+    void run_ensemble(const std::string &output_filename, bool is_implicit);
+    bool run_streaming(std::istream &weather_input, std::ostream &output_file);
+    bool add_environment_sample(double time_s, double solar_irradiance_Wpm2, double ambient_temperature_C, double wind_speed_mps)
+    {
+        return environment_.add_sample(time_s, solar_irradiance_Wpm2, ambient_temperature_C, wind_speed_mps);
+    }
+
+    // Parallel-in-time support (see PararealRunner)
+    unsigned long get_duration_s() const { return duration_s_; }
+    unsigned int get_time_step_s() const { return time_step_s_; }
+    bool get_implicit_solver() const { return is_implicit_solver_; }
+    unsigned int get_current_time_s() const { return current_time_s_; }
+    void set_current_time_s(unsigned int current_time_s) { current_time_s_ = current_time_s; }
+    void use_coarse_solver(unsigned int coarse_step_s);
+    LoopState get_loop_state() const;
+    void set_loop_state(const LoopState &state);
+    void propagate(unsigned long end_time_s, bool is_implicit, std::ostream *output_file);
+};
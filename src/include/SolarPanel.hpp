@@ -1,61 +1,93 @@
-#include "CylinderContainer.hpp"
-
-class Environment;
-class CylinderContainer;
-
-class SolarPanel : public ThermodynamicObject
-{
-private:
-    double width_m_;
-    double length_m_;
-    double ideal_efficiency_;       // Efficiency at ideal temperatures
-    double efficiency_coefficient_; // Efficiency drop per °C over ideal temp (%/°C)
-
-    static constexpr double MAX_IDEAL_TEMPURATURE_C = 25.0;
-    static constexpr double AVERAGE_PANEL_DENSITY_KGPM3 = 2400;
-    static constexpr double PIPE_PANEL_CONTACT_PERCENTAGE = 0.7;
-    static constexpr double LAMINAR_PLATE_MINIMUM_THRESHOLD = 0.05;
-    static constexpr double TURBULENT_FLOW_LOWER_BOUND_FLAT_PLATE = 5e5;
-
-public:
-    SolarPanel() : width_m_(2),
-                   length_m_(2),
-                   ideal_efficiency_(0.225),
-                   efficiency_coefficient_(0.26)
-    {
-        // Assume glass (77%; 840), silicon (14%; 705), and aluminum (9%; 897)
-        specific_heat_capacity_JpkgC_ = 826.23;
-        thickness_m_ = 0.05;
-        emissivity_ = 0.93;
-    }
-
-    void set_wdith(double wid) { width_m_ = wid; }
-    void set_length(double len) { length_m_ = len; }
-    void set_ideal_efficiency(double efficiency) { ideal_efficiency_ = efficiency; }
-    void set_efficiency_coefficient(double coefficient) { efficiency_coefficient_ = coefficient; }
-
-    double get_pipe_contact_percentage() const { return PIPE_PANEL_CONTACT_PERCENTAGE; }
-    double get_surface_area_m2() const { return length_m_ * width_m_; }
-    double get_panel_efficiency() const
-    {
-        if (temperature_C_ <= MAX_IDEAL_TEMPURATURE_C)
-            return ideal_efficiency_;
-
-        return ideal_efficiency_ * 
-               (1.0 - efficiency_coefficient_ * (temperature_C_ - MAX_IDEAL_TEMPURATURE_C));
-    }
-
-    double get_mass_kg() const override
-    {
-        double panel_volume_m3 = length_m_ * width_m_ * thickness_m_;
-
-        return panel_volume_m3 * AVERAGE_PANEL_DENSITY_KGPM3;
-    }
-
-    double get_plate_convective_coefficient_Wpm2K(const Environment &environment, 
-                                                  double current_time_s);
-    void one_second_update_temperature(double intake_water_temperature_C,
-                                       const Environment &environment,
-                                       double current_time,
-                                       CylinderContainer &pipe);
-};
+#pragma once
+
+#include "CylinderContainer.hpp"
+#include "PanelGrid.hpp"
+
+class Environment;
+class CylinderContainer;
+
+class SolarPanel : public ThermodynamicObject
+{
+private:
+    Real width_m_;
+    Real length_m_;
+    Real ideal_efficiency_;       // Efficiency at ideal temperatures
+    Real efficiency_coefficient_; // Efficiency drop per °C over ideal temp (%/°C)
+    PanelGrid grid_;              // Empty: lumped panel temperature
+
+    static constexpr double MAX_IDEAL_TEMPURATURE_C = 25.0;
+    static constexpr double AVERAGE_PANEL_DENSITY_KGPM3 = 2400;
+    static constexpr double PIPE_PANEL_CONTACT_PERCENTAGE = 0.7;
+    static constexpr double LAMINAR_PLATE_MINIMUM_THRESHOLD = 0.05;
+    static constexpr double TURBULENT_FLOW_LOWER_BOUND_FLAT_PLATE = 5e5;
+    static constexpr double COPPER_THERMAL_CONDUCTIVITY_WPMK = 413.0;
+    static constexpr double STEFAN_BOLTZMANN_CONST_WPM2K4 = 5.67e-8; // W / (m^2 * K^4)
+    static constexpr double MIN_PANEL_EFFICIENCY = 0.05;
+
+public:
+    // Heat rates (W) at the current panel and pipe temperatures
+    struct HeatFlows
+    {
+        Real solar_W;
+        Real radiative_loss_W;
+        Real conductive_loss_to_pipe_W;
+        Real convective_loss_air_W;
+    };
+
+    SolarPanel() : width_m_(2),
+                   length_m_(2),
+                   ideal_efficiency_(0.225),
+                   efficiency_coefficient_(0.26)
+    {
+        // Assume glass (77%; 840), silicon (14%; 705), and aluminum (9%; 897)
+        specific_heat_capacity_JpkgC_ = 826.23;
+        thickness_m_ = 0.05;
+        emissivity_ = 0.93;
+    }
+
+    void set_wdith(Real wid) { width_m_ = wid; }
+    void set_length(Real len) { length_m_ = len; }
+    void set_ideal_efficiency(Real efficiency) { ideal_efficiency_ = efficiency; }
+    void set_efficiency_coefficient(Real coefficient) { efficiency_coefficient_ = coefficient; }
+
+    void build_grid(size_t cells, Real thermal_conductivity_WpmK, const CylinderContainer &panel_pipe);
+    bool has_grid() const { return !grid_.empty(); }
+    Real get_max_temperature_C() const { return grid_.empty() ? temperature_C_ : Real(grid_.get_max_temperature_C()); }
+
+    Real get_pipe_contact_percentage() const { return PIPE_PANEL_CONTACT_PERCENTAGE; }
+    Real get_surface_area_m2() const { return length_m_ * width_m_; }
+    Real get_ideal_efficiency() const { return ideal_efficiency_; }
+    Real get_panel_efficiency() const
+    {
+        if (temperature_C_ <= MAX_IDEAL_TEMPURATURE_C)
+            return ideal_efficiency_;
+
+        return ideal_efficiency_ * 
+               (1.0 - efficiency_coefficient_ * (temperature_C_ - MAX_IDEAL_TEMPURATURE_C));
+    }
+
+    Real get_mass_kg() const override
+    {
+        Real panel_volume_m3 = length_m_ * width_m_ * thickness_m_;
+
+        return panel_volume_m3 * AVERAGE_PANEL_DENSITY_KGPM3;
+    }
+
+    void print_cache_key(std::ostream &key) const override;
+    Real get_plate_convective_coefficient_Wpm2K(const Environment &environment, 
+                                                  double current_time_s);
+    HeatFlows get_heat_flows_W(const Environment &environment,
+                               double current_time_s,
+                               const CylinderContainer &panel_pipe);
+    void one_second_update_temperature(Real intake_water_temperature_C,
+                                       const Environment &environment,
+                                       double current_time,
+                                       CylinderContainer &pipe);
+    void one_second_update_surroundings(const Environment &environment,
+                                        double current_time_s,
+                                        CylinderContainer &pipe);
+    void idle_update_temperature(const Environment &environment,
+                                 double current_time_s,
+                                 double step_s,
+                                 CylinderContainer &pipe);
+};
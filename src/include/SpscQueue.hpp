@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+// Bounded lock-free queue between exactly one producer thread and one consumer thread. Each side
+// owns one index and only reads the other's, so a push or pop is a plain store plus one
+// release/acquire pair. The indices sit on separate cache lines so the two cores do not fight over
+// one line. Blocking push/pop spin briefly before yielding: the pipeline hands a value over every
+// few microseconds, which is far shorter than a sleep.
+template <typename T, size_t CAPACITY = 16>
+class SpscQueue
+{
+private:
+    static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+    static constexpr size_t CACHE_LINE_BYTES = 64;
+    static constexpr int SPINS_BEFORE_YIELD = 256;
+
+    std::array<T, CAPACITY> items_;
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> head_; // Next to pop, written by the consumer
+    alignas(CACHE_LINE_BYTES) std::atomic<size_t> tail_; // Next to push, written by the producer
+
+public:
+    SpscQueue() : head_(0), tail_(0) {}
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    bool try_push(const T &item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == CAPACITY)
+            return false;
+        items_[tail & (CAPACITY - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = items_[head & (CAPACITY - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(const T &item)
+    {
+        for (int spins = 0; !try_push(item); spins++)
+        {
+            if (spins >= SPINS_BEFORE_YIELD)
+                std::this_thread::yield();
+        }
+    }
+
+    T pop()
+    {
+        T item;
+        for (int spins = 0; !try_pop(item); spins++)
+        {
+            if (spins >= SPINS_BEFORE_YIELD)
+                std::this_thread::yield();
+        }
+        return item;
+    }
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <ostream>
+
+#include "QuantileSketch.hpp"
+#include "Simulation.hpp"
+
+// Real-time run next to a live installation. A reader thread takes weather rows ("time irradiance
+// ambient wind", as in environment.txt) from a pipe, FIFO or stdin as they arrive and appends them
+// to the simulation's weather. Simulated time starts at the first row's time; from there one of
+// two clocks moves the simulation on:
+//   - input driven (realtime factor 0): each tick moves to the time of the latest row
+//   - wall clock (realtime factor > 0): each tick moves one output step (SIMULATION_TIME_STEP) and is
+//     due step / factor wall seconds after the previous one, counted from the first row's arrival.
+//     Past the latest row the weather holds its values
+// Each tick writes and flushes one state row. Rows that arrive while a tick is computed are taken
+// together by the next tick, and a wall clock run that falls behind jumps to the step that is due,
+// so a slow tick delays the next one instead of building a backlog. Latency runs from the arrival
+// of the oldest row not yet in the log (input driven; a row within the latest second waits for a
+// later one) or the tick's due time (wall clock) to the flush.
+// The run ends when the input closes.
+class StreamRunner
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Sample
+    {
+        double time_s;
+        double solar_irradiance_Wpm2;
+        double ambient_temperature_C;
+        double wind_speed_mps;
+        Clock::time_point arrival;
+    };
+
+    Simulation &simulation_;
+    bool is_implicit_;
+    double realtime_factor_;    // Simulated seconds per wall second, 0: the input is the clock
+    double latency_budget_ms_;
+
+    std::deque<Sample> samples_;
+    bool is_input_closed_ = false;
+    std::mutex samples_mutex_;
+    std::condition_variable samples_available_;
+
+    bool is_row_pending_ = false; // Input driven: a taken row is not in the log yet
+    Clock::time_point pending_since_;
+
+    unsigned long samples_received_ = 0;
+    unsigned long samples_rejected_ = 0; // Not later than the row before
+    unsigned long ticks_skipped_ = 0;    // Wall clock: steps passed without a row to catch up
+    unsigned long rows_ = 0;
+    unsigned long rows_over_budget_ = 0;
+    double max_latency_ms_ = 0.0;
+    QuantileSketch latency_p50_ms_ = QuantileSketch(0.5);
+    QuantileSketch latency_p95_ms_ = QuantileSketch(0.95);
+    QuantileSketch latency_p99_ms_ = QuantileSketch(0.99);
+
+    void read(std::istream &input);
+    size_t take_samples();
+    void emit(std::ostream &output_file, Clock::time_point since);
+    void run_input_driven(std::ostream &output_file);
+    void follow_input(std::ostream &output_file);
+    void run_wall_clock(std::ostream &output_file, Clock::time_point start, unsigned long start_time_s);
+
+public:
+    StreamRunner(Simulation &simulation, bool is_implicit, double realtime_factor, double latency_budget_ms);
+
+    void run(std::istream &input, std::ostream &output_file);
+    void print_statistics(std::ostream &output) const;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "Real.hpp"
+
+// Two smooth outputs of two inputs, sampled on a regular grid and bilinearly interpolated.
+// Built once from an exact (expensive) evaluation. Every cell is checked against both exact outputs
+// at its centre; cells where either is off by more than its tolerance (e.g. straddling a flow
+// regime change) and points outside the grid report a miss so the caller can evaluate exactly.
+class SurrogateTable
+{
+private:
+    double x_min_, y_min_, step_;
+    size_t x_count_, y_count_;
+    std::vector<std::array<double, 2>> values_; // Row-major, x outer
+    std::vector<bool> is_cell_valid_;           // (x_count_ - 1) * (y_count_ - 1), same order
+    std::array<double, 2> max_error_;           // Of each output, over valid cells
+    size_t invalid_cells_;
+
+    void interpolate(size_t i, size_t j, Real u, Real v, Real &first, Real &second) const
+    {
+        const std::array<double, 2> &v00 = values_[i * y_count_ + j], &v01 = values_[i * y_count_ + j + 1];
+        const std::array<double, 2> &v10 = values_[(i + 1) * y_count_ + j], &v11 = values_[(i + 1) * y_count_ + j + 1];
+        first = (1.0 - u) * ((1.0 - v) * v00[0] + v * v01[0]) + u * ((1.0 - v) * v10[0] + v * v11[0]);
+        second = (1.0 - u) * ((1.0 - v) * v00[1] + v * v01[1]) + u * ((1.0 - v) * v10[1] + v * v11[1]);
+    }
+
+public:
+    using Evaluate = std::function<void(double x, double y, double &first, double &second)>;
+
+    SurrogateTable() : x_min_(0.0),
+                       y_min_(0.0),
+                       step_(1.0),
+                       x_count_(0),
+                       y_count_(0),
+                       max_error_{0.0, 0.0},
+                       invalid_cells_(0) {}
+
+    bool empty() const { return values_.empty(); }
+    size_t size() const { return values_.size(); }
+    size_t get_cell_count() const { return is_cell_valid_.size(); }
+    size_t get_invalid_cell_count() const { return invalid_cells_; }
+    double get_max_error(size_t output) const { return max_error_[output]; }
+
+    void build(double x_min, double x_max, double y_min, double y_max, double step,
+               double first_tolerance, double second_tolerance, const Evaluate &evaluate);
+
+    bool lookup(Real x, Real y, Real &first, Real &second) const
+    {
+        if (values_.empty())
+            return false;
+        Real x_cells = (x - x_min_) / step_, y_cells = (y - y_min_) / step_;
+        if (!(x_cells >= 0.0 && y_cells >= 0.0 &&
+              x_cells <= static_cast<double>(x_count_ - 1) && y_cells <= static_cast<double>(y_count_ - 1)))
+            return false;
+
+        // Last row/column share the cell below them
+        size_t i = std::min(static_cast<size_t>(value_of(x_cells)), x_count_ - 2);
+        size_t j = std::min(static_cast<size_t>(value_of(y_cells)), y_count_ - 2);
+        if (!is_cell_valid_[i * (y_count_ - 1) + j])
+            return false;
+
+        interpolate(i, j, x_cells - static_cast<double>(i), y_cells - static_cast<double>(j), first, second);
+        return true;
+    }
+};
@@ -1,50 +1,76 @@
-#define _USE_MATH_DEFINES
-#include <cmath>
-#include <iostream>
-#include <algorithm>
-
-class ThermodynamicObject
-{
-protected:
-    double temperature_C_;                // °C
-    double water_temperature_C_;          // °C
-    double water_out_temperature_C_;      // °C
-    double emissivity_;                   // 0 (perfect reflector) to 1 (perfect emitter)
-    double thickness_m_;                  // m
-    double specific_heat_capacity_JpkgC_; // J/(kg * °C)
-
-    static constexpr double LAMINAR_FLOW_UPPER_BOUND = 2300;
-    static constexpr double TURBULENT_FLOW_FULLY_DEVELOPED_DISTANCE_M = 10.0;
-
-public:
-    ThermodynamicObject() : temperature_C_(15.5),
-                            water_temperature_C_(15.5),
-                            water_out_temperature_C_(15.5),
-                            emissivity_(0.64),
-                            thickness_m_(0.00055),                 // 0.55 mm thickness
-                            specific_heat_capacity_JpkgC_(376.812) /* Copper */
-    {
-    }
-
-    double get_water_out_temperature_C() const { return water_out_temperature_C_; }
-    double get_water_density_kgpm3(double water_tempurature_C) const;
-    double get_water_dynamic_viscosity_kgpms(double tempurature_C) const;
-    double get_water_thermal_conductivity_WpmK(double tempurature_C) const;
-    double get_water_specific_heat_capacity_JpkgC(double tempurature_C) const;
-
-    double get_temperature() const { return temperature_C_; }
-    virtual double get_mass_kg() const = 0;
-
-    void set_temperature(double temp) { temperature_C_ = temp; }
-    void set_thickness(double thick) { thickness_m_ = thick; }
-    void set_emissivity(double emiss) { emissivity_ = std::clamp(emiss, 0.0, 1.0); } // Always between 0 and 1
-    void set_water_temperature(double temp) { water_temperature_C_ = temp; }
-    void set_specific_heat_capacity(double capacity) { specific_heat_capacity_JpkgC_ = capacity; }
-
-    void add_tempurature(double total_energy_added_J)
-    {
-        double tempurature_delta_K = total_energy_added_J /
-                                     (specific_heat_capacity_JpkgC_ * get_mass_kg());
-        temperature_C_ += tempurature_delta_K;
-    }
-};
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "Real.hpp"
+
+class ThermodynamicObject
+{
+public:
+    // Energy exchanged during the most recent one second update (J)
+    struct EnergyFlows
+    {
+        Real solar_absorbed_J = 0.0;
+        Real convective_loss_J = 0.0;
+        Real radiative_loss_J = 0.0;
+        Real conducted_out_J = 0.0;        // Solid to solid (e.g. panel into its pipe)
+        Real transferred_to_water_J = 0.0; // Wall into the water flowing past it
+        Real water_heat_input_J = 0.0;     // Loop water delivered into stored (tank) water
+    };
+
+protected:
+    Real temperature_C_;                // °C
+    Real water_temperature_C_;          // °C
+    Real water_out_temperature_C_;      // °C
+    Real emissivity_;                   // 0 (perfect reflector) to 1 (perfect emitter)
+    Real thickness_m_;                  // m
+    Real specific_heat_capacity_JpkgC_; // J/(kg * °C)
+    EnergyFlows energy_flows_;
+
+    static constexpr double LAMINAR_FLOW_UPPER_BOUND = 2300;
+    static constexpr double TURBULENT_FLOW_FULLY_DEVELOPED_DISTANCE_M = 10.0;
+
+public:
+    ThermodynamicObject() : temperature_C_(15.5),
+                            water_temperature_C_(15.5),
+                            water_out_temperature_C_(15.5),
+                            emissivity_(0.64),
+                            thickness_m_(0.00055),                 // 0.55 mm thickness
+                            specific_heat_capacity_JpkgC_(376.812) /* Copper */
+    {
+    }
+
+    Real get_water_out_temperature_C() const { return water_out_temperature_C_; }
+    Real get_water_density_kgpm3(Real water_tempurature_C) const;
+    Real get_water_dynamic_viscosity_kgpms(Real tempurature_C) const;
+    Real get_water_thermal_conductivity_WpmK(Real tempurature_C) const;
+    Real get_water_specific_heat_capacity_JpkgC(Real tempurature_C) const;
+
+    Real get_temperature() const { return temperature_C_; }
+    Real get_water_temperature_C() const { return water_temperature_C_; }
+    Real get_emissivity() const { return emissivity_; }
+    const EnergyFlows &get_energy_flows() const { return energy_flows_; }
+    Real get_heat_capacity_JpK() const { return specific_heat_capacity_JpkgC_ * get_mass_kg(); }
+    Real get_stored_energy_J() const { return get_heat_capacity_JpK() * temperature_C_; }
+    virtual Real get_mass_kg() const = 0;
+    // Every field the log depends on, space separated (see Simulation::get_cache_key)
+    virtual void print_cache_key(std::ostream &key) const;
+
+    void set_temperature(Real temp) { temperature_C_ = temp; }
+    void set_thickness(Real thick) { thickness_m_ = thick; }
+    void set_emissivity(Real emiss) { emissivity_ = std::clamp<Real>(emiss, 0.0, 1.0); } // Always between 0 and 1
+    void set_water_temperature(Real temp) { water_temperature_C_ = temp; }
+    void set_water_out_temperature(Real temp) { water_out_temperature_C_ = temp; }
+    void set_energy_flows(const EnergyFlows &flows) { energy_flows_ = flows; }
+    void set_specific_heat_capacity(Real capacity) { specific_heat_capacity_JpkgC_ = capacity; }
+
+    void add_tempurature(Real total_energy_added_J)
+    {
+        Real tempurature_delta_K = total_energy_added_J /
+                                     (specific_heat_capacity_JpkgC_ * get_mass_kg());
+        temperature_C_ += tempurature_delta_K;
+    }
+};
@@ -1,10 +1,85 @@
-#include "include/Simulation.hpp"
-
-int main()
-{
-    Simulation simulation;
-    simulation.run_simulation("input/overrides.txt",
-                              "input/environment.txt",
-                              "output/simulation_log.txt");
-    return 0;
-}
+#include <cstdlib>
+#include <thread>
+
+#include "include/DesignOptimizer.hpp"
+#include "include/JobServer.hpp"
+#include "include/ResultCache.hpp"
+#include "include/ScenarioRunner.hpp"
+
+int main(int argc, char *argv[])
+{
+    // ./PhysicsSimulatorTest --scenarios [corpus directory] [name filter]
+    // ./PhysicsSimulatorTest --record-scenarios [corpus directory] [name filter]
+    // ./PhysicsSimulatorTest --serve [worker count] < jobs.ndjson
+    // ./PhysicsSimulatorTest --optimize [spec file] [overrides file] [environment file]
+    // ./PhysicsSimulatorTest --cache-stats [cache directory]
+    // ./PhysicsSimulatorTest --stream [weather pipe or FIFO, default stdin] > states.txt
+    if (argc > 1 && (std::string(argv[1]) == "--scenarios" || std::string(argv[1]) == "--record-scenarios"))
+    {
+        ScenarioRunner runner;
+        return runner.run_all(argc > 2 ? argv[2] : "scenarios",
+                              argc > 3 ? argv[3] : "",
+                              std::string(argv[1]) == "--record-scenarios");
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--serve")
+    {
+        unsigned int worker_count = std::thread::hardware_concurrency();
+        if (argc > 2)
+        {
+            char *end = nullptr;
+            unsigned long count = std::strtoul(argv[2], &end, 10);
+            if (end == argv[2] || *end != '\0' || argv[2][0] == '-' || count == 0 || count > 4096)
+            {
+                std::cerr << "Usage: " << argv[0] << " --serve [worker count, 1 to 4096] < jobs.ndjson" << std::endl;
+                return 1;
+            }
+            worker_count = static_cast<unsigned int>(count);
+        }
+        JobServer server;
+        return server.serve(std::cin, worker_count);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--optimize")
+    {
+        Simulation simulation;
+        simulation.read_simulation_constants(argc > 3 ? argv[3] : "input/optimize_overrides.txt");
+        Environment environment;
+        environment.read_environmental_conditions(argc > 4 ? argv[4] : "input/optimize_environment.txt");
+        simulation.set_environment(environment);
+
+        DesignOptimizer optimizer(simulation);
+        if (!optimizer.read_spec(argc > 2 ? argv[2] : "input/optimize.txt"))
+            return 1;
+        return optimizer.run(std::cout);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--cache-stats")
+    {
+        ResultCache cache(argc > 2 ? argv[2] : ResultCache::DEFAULT_DIRECTORY, /*max_bytes*/ 0);
+        cache.print_summary(std::cout);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--stream")
+    {
+        Simulation simulation;
+        simulation.read_simulation_constants("input/overrides.txt");
+        if (argc <= 2 || std::string(argv[2]) == "-")
+            return simulation.run_streaming(std::cin, std::cout) ? 0 : 1;
+
+        std::ifstream weather_input(argv[2]);
+        if (!weather_input.is_open())
+        {
+            std::cerr << "Error opening input file: " << argv[2] << std::endl;
+            return 1;
+        }
+        return simulation.run_streaming(weather_input, std::cout) ? 0 : 1;
+    }
+
+    Simulation simulation;
+    simulation.run_simulation("input/overrides.txt",
+                              "input/environment.txt",
+                              "output/simulation_log.txt");
+    return 0;
+}